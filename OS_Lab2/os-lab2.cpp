@@ -1,4 +1,7 @@
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -11,11 +14,13 @@
 #include <queue>
 #include <stack>
 #include <iomanip>
+#include <algorithm>
 
 using namespace std;
 
-bool VERBOSE = false;
-string INPUT_FILE, RAND_FILE, SCHEDULING_ALGO_PARAM;
+bool VERBOSE = false, STREAM_STATS = false, RAND_CACHE = false;
+string INPUT_FILE, RAND_FILE, SCHEDULING_ALGO_PARAM, CHECKPOINT_FILE, RESUME_FILE;
+int CHECKPOINT_TIME = -1;
 int QUANTUM = 10000, MAX_PRIO = 4;
 int RAND_OFFSET = 0, RAND_LIMIT = 0;
 int LAST_EVENT_TIME = 0, IO_TIME = 0, CPU_TIME = 0, PREVIOUS_TIMESTAMP = 0, IO_PROCESS_COUNT = 0;
@@ -28,12 +33,13 @@ const char* ProcessStateText[] = {"CREATED", "READY", "RUNNG", "BLOCK", "COMPLET
 class Process {
     public:
     int id, arrivalTime, totalCpuTime, cpuBurst, ioBurst, staticPriority, dynamicPriority;
-    int stateTs, waitTime, ioTime, remainingTime, quantumTime, completedTime;
+    int stateTs, waitTime, ioTime, remainingTime, quantumTime, completedTime, cpuAccounted;
+    long long vruntime;
     ProcessState processState;
 
     Process(int id, int arTime, int cpuTime, int cpuBurst, int ioBurst, int prio, ProcessState state): id(id), arrivalTime(arTime), stateTs(arrivalTime), totalCpuTime(cpuTime), 
         remainingTime(cpuTime), cpuBurst(cpuBurst), ioBurst(ioBurst), staticPriority(prio), dynamicPriority(prio - 1), processState(state) {
-            waitTime = 0, ioTime = 0, quantumTime = 0, completedTime = 0;
+            waitTime = 0, ioTime = 0, quantumTime = 0, completedTime = 0, cpuAccounted = 0, vruntime = 0;
         }
 };
 
@@ -46,12 +52,45 @@ class Event {
     Event(int ts, Process* p, TransitionState state): timestamp(ts), process(p), transition(state) {}
 };
 
+class DES;
+
 class Scheduler {
     public:
     virtual string getAlgorithmName() = 0;
     virtual void addProcess(Process* process) = 0;
     virtual Process* getNextProcess() = 0;
     virtual bool doesPreempt() = 0;
+    virtual void simulate(DES* des) = 0;
+    virtual void save(ostream& out) = 0;
+    virtual void load(istream& in, map<int, Process*>& processes) = 0;
+
+    virtual int getTimeSlice(Process* process) {
+        return QUANTUM;
+    }
+
+    virtual bool preempts(Process* ready, Process* running, int currentTime) {
+        return ready->dynamicPriority > running->dynamicPriority;
+    }
+
+    // whether a preempted process drops a dynamic priority level, the prio= shown by -v
+    virtual bool decaysPriority() {
+        return true;
+    }
+};
+
+// schedulers derive from this with their own type so the simulation loop is instantiated per
+// scheduler, the only virtual call left is simulate() itself
+template<typename S> class SchedulerImpl: public Scheduler {
+    public:
+    void simulate(DES* des);
+};
+
+struct NoTrace {
+    static const bool ENABLED = false;
+};
+
+struct VerboseTrace {
+    static const bool ENABLED = true;
 };
 
 class DES {
@@ -74,6 +113,16 @@ class DES {
         }
     }
 
+    // arrivals are injected one at a time while the simulation runs, so they are placed ahead of
+    // any event with the same timestamp, exactly where they would be had they all been queued at t=0
+    void putArrivalEvent(Event* event) {
+        list<Event*>::iterator it = evtList.begin();
+        while (it != evtList.end() && event->timestamp > (*it)->timestamp) {
+            it++;
+        }
+        evtList.insert(it, event);
+    }
+
     Event* getEvent() {
         if (evtList.empty()) {
             return nullptr;
@@ -86,7 +135,8 @@ class DES {
     bool removeEvent(int timestamp, Process* process, TransitionState transition) {
         for (list<Event*>::iterator it = evtList.begin(); it != evtList.end(); it++) {
             if ((*it)->timestamp != timestamp && process == (*it)->process && transition == (*it)->transition) {
-                evtList.remove(*it);
+                delete *it;
+                evtList.erase(it);
                 return true;
             }
         }
@@ -101,12 +151,37 @@ class DES {
     }
 };
 
-vector<int> randvals;
+// ready queues are written to checkpoints as "<count> <pid> <pid> ..." in pick order
+void saveQueue(ostream& out, queue<Process*> q) {
+    out << q.size();
+    while (! q.empty()) {
+        out << " " << q.front()->id;
+        q.pop();
+    }
+    out << "\n";
+}
+
+void loadQueue(istream& in, map<int, Process*>& processes, queue<Process*>& q) {
+    int count, id;
+    in >> count;
+    for (int i = 0; i < count; i++) {
+        in >> id;
+        q.push(processes[id]);
+    }
+}
+
+// points either into randStorage or straight into a mapped binary cache of the rfile
+const int* randvals = nullptr;
+vector<int> randStorage;
 vector<Process*> processList;
+// in -l mode completed processes are freed, this holds the ones still in the system for checkpoints
+map<int, Process*> liveProcesses;
+unsigned long PROCESS_COUNT = 0;
+double TOTAL_TURNAROUND = 0.0, TOTAL_WAIT = 0.0;
 Process* CURRENT_RUNNING_PROCESS;
 Event* PROCESS_EVT;
 
-class FCFS: public Scheduler {
+class FCFS final: public SchedulerImpl<FCFS> {
     private:
     queue<Process*> processQueue;
 
@@ -131,9 +206,17 @@ class FCFS: public Scheduler {
     bool doesPreempt() {
         return false;
     }
+
+    void save(ostream& out) {
+        saveQueue(out, processQueue);
+    }
+
+    void load(istream& in, map<int, Process*>& processes) {
+        loadQueue(in, processes, processQueue);
+    }
 };
 
-class LCFS: public Scheduler {
+class LCFS final: public SchedulerImpl<LCFS> {
     private:
     stack<Process*> processStack;
 
@@ -158,9 +241,33 @@ class LCFS: public Scheduler {
     bool doesPreempt() {
         return false;
     }
+
+    // written top first, so the stack is rebuilt from the bottom
+    void save(ostream& out) {
+        stack<Process*> st = processStack;
+        out << st.size();
+        while (! st.empty()) {
+            out << " " << st.top()->id;
+            st.pop();
+        }
+        out << "\n";
+    }
+
+    void load(istream& in, map<int, Process*>& processes) {
+        int count, id;
+        in >> count;
+        vector<Process*> ordered;
+        for (int i = 0; i < count; i++) {
+            in >> id;
+            ordered.push_back(processes[id]);
+        }
+        for (auto it = ordered.rbegin(); it != ordered.rend(); ++it) {
+            processStack.push(*it);
+        }
+    }
 };
 
-class SRTF: public Scheduler {
+class SRTF final: public SchedulerImpl<SRTF> {
     private:
     list<Process*> processQueue;
 
@@ -197,9 +304,26 @@ class SRTF: public Scheduler {
     bool doesPreempt() {
         return false;
     }
+
+    void save(ostream& out) {
+        out << processQueue.size();
+        for (Process* p : processQueue) {
+            out << " " << p->id;
+        }
+        out << "\n";
+    }
+
+    void load(istream& in, map<int, Process*>& processes) {
+        int count, id;
+        in >> count;
+        for (int i = 0; i < count; i++) {
+            in >> id;
+            processQueue.push_back(processes[id]);
+        }
+    }
 };
 
-class RR: public Scheduler {
+class RR final: public SchedulerImpl<RR> {
     private:
     queue<Process*> processQueue;
 
@@ -227,9 +351,17 @@ class RR: public Scheduler {
     bool doesPreempt() {
         return false;
     }
+
+    void save(ostream& out) {
+        saveQueue(out, processQueue);
+    }
+
+    void load(istream& in, map<int, Process*>& processes) {
+        loadQueue(in, processes, processQueue);
+    }
 };
 
-class PRIO: public Scheduler {
+class PRIO final: public SchedulerImpl<PRIO> {
     private:
     int prio;
     vector<queue<Process*>> activeQueue;
@@ -288,9 +420,23 @@ class PRIO: public Scheduler {
     bool doesPreempt() {
         return false;
     }
+
+    void save(ostream& out) {
+        for (int i = 0; i < prio; i++) {
+            saveQueue(out, activeQueue[i]);
+            saveQueue(out, expiredQueue[i]);
+        }
+    }
+
+    void load(istream& in, map<int, Process*>& processes) {
+        for (int i = 0; i < prio; i++) {
+            loadQueue(in, processes, activeQueue[i]);
+            loadQueue(in, processes, expiredQueue[i]);
+        }
+    }
 };
 
-class PREPRIO: public Scheduler {
+class PREPRIO final: public SchedulerImpl<PREPRIO> {
     private:
     int prio;
     vector<queue<Process*>> activeQueue;
@@ -352,6 +498,120 @@ class PREPRIO: public Scheduler {
     bool doesPreempt() {
         return true;
     }
+
+    void save(ostream& out) {
+        for (int i = 0; i < prio; i++) {
+            saveQueue(out, activeQueue[i]);
+            saveQueue(out, expiredQueue[i]);
+        }
+    }
+
+    void load(istream& in, map<int, Process*>& processes) {
+        for (int i = 0; i < prio; i++) {
+            loadQueue(in, processes, activeQueue[i]);
+            loadQueue(in, processes, expiredQueue[i]);
+        }
+    }
+};
+
+class CFS final: public SchedulerImpl<CFS> {
+    private:
+    struct VruntimeOrder {
+        bool operator()(Process* a, Process* b) const {
+            return a->vruntime != b->vruntime ? a->vruntime < b->vruntime : a->id < b->id;
+        }
+    };
+
+    static const int NICE_0_WEIGHT = 1024;
+    int latency, minGranularity;
+    long long minVruntime = 0, totalWeight = 0;
+    vector<int> weights;
+    // red-black tree, begin() is the cached leftmost node so picking the next process is O(1)
+    set<Process*, VruntimeOrder> runQueue;
+
+    int getWeight(Process* process) {
+        return weights[process->staticPriority - 1];
+    }
+
+    // charges cpu time used since the last call and keeps sleepers from banking more than half a
+    // latency period of credit, safe to call more than once before the process is queued
+    void placeProcess(Process* process) {
+        int ran = (process->totalCpuTime - process->remainingTime) - process->cpuAccounted;
+        process->cpuAccounted = process->cpuAccounted + ran;
+        process->vruntime = process->vruntime + (long long) ran * NICE_0_WEIGHT / getWeight(process);
+        process->vruntime = max(process->vruntime, minVruntime - latency / 2);
+    }
+
+    public:
+    CFS(int latencyTarget, int priority): latency(latencyTarget), minGranularity(max(1, latencyTarget / 8)) {
+        // every priority level gets 25% more cpu than the one below it
+        double weight = NICE_0_WEIGHT;
+        for (int i = 0; i < priority; i++) {
+            weights.push_back((int) weight);
+            weight = weight * 1.25;
+        }
+    }
+
+    string getAlgorithmName() {
+        return "CFS " + to_string(latency);
+    }
+
+    void addProcess(Process* process) {
+        placeProcess(process);
+        runQueue.insert(process);
+        totalWeight = totalWeight + getWeight(process);
+    }
+
+    Process* getNextProcess() {
+        if (runQueue.empty()) {
+            return nullptr;
+        }
+        Process* p = *runQueue.begin();
+        runQueue.erase(runQueue.begin());
+        totalWeight = totalWeight - getWeight(p);
+        minVruntime = max(minVruntime, p->vruntime);
+        return p;
+    }
+
+    bool doesPreempt() {
+        return true;
+    }
+
+    // the running process gets its weighted share of the latency target, never less than minGranularity
+    int getTimeSlice(Process* process) {
+        long long weight = getWeight(process);
+        return max((long long) minGranularity, latency * weight / (totalWeight + weight));
+    }
+
+    // a woken process preempts once it is more than minGranularity of vruntime behind the running one
+    bool preempts(Process* ready, Process* running, int currentTime) {
+        placeProcess(ready);
+        long long runningVruntime = running->vruntime + (long long) (currentTime - running->stateTs) * NICE_0_WEIGHT / getWeight(running);
+        return ready->vruntime + minGranularity < runningVruntime;
+    }
+
+    // shares follow the static priority's weight, the dynamic one stays at its initial level
+    bool decaysPriority() {
+        return false;
+    }
+
+    void save(ostream& out) {
+        out << minVruntime << " " << runQueue.size();
+        for (Process* p : runQueue) {
+            out << " " << p->id;
+        }
+        out << "\n";
+    }
+
+    void load(istream& in, map<int, Process*>& processes) {
+        int count, id;
+        in >> minVruntime >> count;
+        for (int i = 0; i < count; i++) {
+            in >> id;
+            runQueue.insert(processes[id]);
+            totalWeight = totalWeight + getWeight(processes[id]);
+        }
+    }
 };
 
 int getRandomNumber(int burst) {
@@ -360,58 +620,770 @@ int getRandomNumber(int burst) {
     return val;
 }
 
-void readInputFile(string fileName, DES& des) {
-    ifstream inputFile(fileName);
-    int id = 0;
-    if (inputFile.is_open()) {
-        string line;
-        while (getline(inputFile, line)) {
+// Log-linear histogram: values below 32 get their own bucket, above that every power of two is split
+// into 16 buckets, so a reported percentile is within 1/16 of the true value. Fixed size, no allocation.
+class LatencyHistogram {
+    private:
+    static const int SUB_BITS = 4, SUB_BUCKETS = 1 << SUB_BITS, NUM_BUCKETS = (31 - SUB_BITS + 1) * SUB_BUCKETS;
+    unsigned long long buckets[NUM_BUCKETS] = {};
+    unsigned long long count = 0;
+    int maxValue = 0;
+
+    int getBucket(int value) {
+        if (value < 2 * SUB_BUCKETS) {
+            return value;
+        }
+        int exponent = 31 - __builtin_clz(value);
+        return (exponent - SUB_BITS) * SUB_BUCKETS + (value >> (exponent - SUB_BITS));
+    }
+
+    int getBucketStart(int bucket) {
+        if (bucket < 2 * SUB_BUCKETS) {
+            return bucket;
+        }
+        int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+        return (bucket % SUB_BUCKETS + SUB_BUCKETS) << (exponent - SUB_BITS);
+    }
+
+    public:
+    void record(int value) {
+        value = max(value, 0);
+        buckets[getBucket(value)]++;
+        count++;
+        maxValue = max(maxValue, value);
+    }
+
+    int getPercentile(double percentile) {
+        unsigned long long rank = (unsigned long long) (percentile / 100.0 * count + 0.5), seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            seen = seen + buckets[i];
+            if (seen >= max(rank, 1ULL)) {
+                return min(getBucketStart(i), maxValue);
+            }
+        }
+        return maxValue;
+    }
+
+    // non-empty buckets only, for checkpoints
+    void save(ostream& out) {
+        int used = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            used = used + (buckets[i] != 0);
+        }
+        out << count << " " << maxValue << " " << used;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            if (buckets[i] != 0) {
+                out << " " << i << " " << buckets[i];
+            }
+        }
+        out << "\n";
+    }
+
+    void load(istream& in) {
+        int used, bucket;
+        in >> count >> maxValue >> used;
+        for (int i = 0; i < used; i++) {
+            in >> bucket;
+            in >> buckets[bucket];
+        }
+    }
+
+    void print(const char* name) {
+        printf("%s: n=%llu p50=%d p99=%d p99.9=%d max=%d\n", name, count, getPercentile(50), getPercentile(99), getPercentile(99.9), maxValue);
+    }
+};
+
+// -m<window>: cpu and io utilization per time window plus latency histograms
+class SimulationMetrics {
+    public:
+    int window;
+    vector<int> cpuBusy, ioBusy;
+    LatencyHistogram waitTime, turnaround, queueDelay;
+
+    SimulationMetrics(int window): window(window) {}
+
+    // spreads the busy interval [from, to) over the windows it covers
+    void addBusy(vector<int>& busy, int from, int to) {
+        while (from < to) {
+            int w = from / window, windowEnd = (w + 1) * window;
+            if ((int) busy.size() <= w) {
+                busy.resize(w + 1, 0);
+            }
+            int end = min(to, windowEnd);
+            busy[w] = busy[w] + (end - from);
+            from = end;
+        }
+    }
+
+    void saveBusy(ostream& out, vector<int>& busy) {
+        out << busy.size();
+        for (int b : busy) {
+            out << " " << b;
+        }
+        out << "\n";
+    }
+
+    void loadBusy(istream& in, vector<int>& busy) {
+        size_t count;
+        in >> count;
+        busy.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            in >> busy[i];
+        }
+    }
+
+    void save(ostream& out) {
+        out << window << "\n";
+        saveBusy(out, cpuBusy);
+        saveBusy(out, ioBusy);
+        waitTime.save(out);
+        turnaround.save(out);
+        queueDelay.save(out);
+    }
+
+    void load(istream& in) {
+        loadBusy(in, cpuBusy);
+        loadBusy(in, ioBusy);
+        waitTime.load(in);
+        turnaround.load(in);
+        queueDelay.load(in);
+    }
+
+    void print() {
+        int windows = (LAST_EVENT_TIME + window - 1) / window;
+        for (int w = 0; w < windows; w++) {
+            int length = min(window, LAST_EVENT_TIME - w * window);
+            int cpu = w < (int) cpuBusy.size() ? cpuBusy[w] : 0, io = w < (int) ioBusy.size() ? ioBusy[w] : 0;
+            printf("WINDOW: %d %.2lf %.2lf\n", w * window, (cpu * 100.0) / length, (io * 100.0) / length);
+        }
+        waitTime.print("WAIT");
+        turnaround.print("TURNAROUND");
+        queueDelay.print("QUEUEDELAY");
+    }
+};
+
+SimulationMetrics* METRICS = nullptr;
+
+class IORequest {
+    public:
+    Process* process;
+    int track, transferTime, submitTime;
+    long seq;
+
+    IORequest(Process* p, int track, int transfer, int submit, long seq): process(p), track(track), transferTime(transfer), submitTime(submit), seq(seq) {}
+};
+
+// orders pending requests by track, ties go to the request submitted first
+struct TrackOrder {
+    bool operator()(IORequest* a, IORequest* b) const {
+        return a->track != b->track ? a->track < b->track : a->seq < b->seq;
+    }
+};
+
+class DiskScheduler {
+    public:
+    virtual string getAlgorithmName() = 0;
+    virtual void addRequest(IORequest* request) = 0;
+    virtual IORequest* getNextRequest(int head) = 0;
+    // pending requests in submission order, for checkpoints
+    virtual vector<IORequest*> getPendingRequests() = 0;
+};
+
+class DiskFIFO: public DiskScheduler {
+    private:
+    list<IORequest*> requestQueue;
+
+    public:
+    string getAlgorithmName() {
+        return "FIFO";
+    }
+
+    void addRequest(IORequest* request) {
+        requestQueue.push_back(request);
+    }
+
+    IORequest* getNextRequest(int) {
+        if (requestQueue.empty()) {
+            return nullptr;
+        }
+        IORequest* r = requestQueue.front();
+        requestQueue.pop_front();
+        return r;
+    }
+
+    vector<IORequest*> getPendingRequests() {
+        return vector<IORequest*>(requestQueue.begin(), requestQueue.end());
+    }
+};
+
+class DiskSSTF: public DiskScheduler {
+    protected:
+    set<IORequest*, TrackOrder> requests;
+
+    // first request at or above the head and the last one below it
+    void getNeighbours(int head, set<IORequest*, TrackOrder>::iterator& up, set<IORequest*, TrackOrder>::iterator& down) {
+        IORequest probe(nullptr, head, 0, 0, -1);
+        up = requests.lower_bound(&probe);
+        down = requests.end();
+        if (up != requests.begin()) {
+            down = prev(up);
+            // the lowest seq among the requests on the nearest track below
+            while (down != requests.begin() && (*prev(down))->track == (*down)->track) {
+                down--;
+            }
+        }
+    }
+
+    public:
+    string getAlgorithmName() {
+        return "SSTF";
+    }
+
+    void addRequest(IORequest* request) {
+        requests.insert(request);
+    }
+
+    IORequest* getNextRequest(int head) {
+        if (requests.empty()) {
+            return nullptr;
+        }
+        set<IORequest*, TrackOrder>::iterator up, down;
+        getNeighbours(head, up, down);
+        auto it = up;
+        if (up == requests.end() || (down != requests.end() && head - (*down)->track < (*up)->track - head)) {
+            it = down;
+        }
+        IORequest* r = *it;
+        requests.erase(it);
+        return r;
+    }
+
+    vector<IORequest*> getPendingRequests() {
+        vector<IORequest*> pending(requests.begin(), requests.end());
+        sort(pending.begin(), pending.end(), [](IORequest* a, IORequest* b) { return a->seq < b->seq; });
+        return pending;
+    }
+};
+
+class DiskLOOK: public DiskSSTF {
+    public:
+    int direction = 1;
+
+    string getAlgorithmName() {
+        return "LOOK";
+    }
+
+    IORequest* getNextRequest(int head) {
+        if (requests.empty()) {
+            return nullptr;
+        }
+        set<IORequest*, TrackOrder>::iterator up, down;
+        getNeighbours(head, up, down);
+        // a request on the head's track needs no seek whichever way the head is sweeping
+        if (up != requests.end() && (*up)->track == head) {
+            IORequest* r = *up;
+            requests.erase(up);
+            return r;
+        }
+        if (direction == 1 && up == requests.end()) {
+            direction = -1;
+        } else if (direction == -1 && down == requests.end()) {
+            direction = 1;
+        }
+        auto it = direction == 1 ? up : down;
+        IORequest* r = *it;
+        requests.erase(it);
+        return r;
+    }
+};
+
+// -d<N|S|L>[:tracks]: blocked processes queue on one disk instead of all doing io in parallel. The head
+// moves one track per time unit, a request takes the seek plus its io burst as transfer time.
+class Disk {
+    public:
+    DiskScheduler* scheduler;
+    int tracks, head = 0;
+    IORequest* active = nullptr;
+    long seq = 0, completed = 0, totalMovement = 0, busyTime = 0, totalQueueTime = 0;
+
+    Disk(DiskScheduler* sched, int tracks): scheduler(sched), tracks(tracks) {}
+
+    void start(IORequest* request, DES* des, int currentTime) {
+        int seek = abs(request->track - head);
+        totalMovement = totalMovement + seek;
+        busyTime = busyTime + seek + request->transferTime;
+        totalQueueTime = totalQueueTime + (currentTime - request->submitTime);
+        head = request->track;
+        active = request;
+        des->putEvent(new Event(currentTime + seek + request->transferTime, request->process, TRANS_TO_READY));
+    }
+
+    void submit(Process* process, int transferTime, DES* des, int currentTime) {
+        IORequest* request = new IORequest(process, getRandomNumber(tracks) - 1, transferTime, currentTime, seq++);
+        if (active == nullptr) {
+            start(request, des, currentTime);
+        } else {
+            scheduler->addRequest(request);
+        }
+    }
+
+    void complete(DES* des, int currentTime) {
+        delete active;
+        active = nullptr;
+        completed++;
+        IORequest* next = scheduler->getNextRequest(head);
+        if (next != nullptr) {
+            start(next, des, currentTime);
+        }
+    }
+
+    void save(ostream& out) {
+        out << scheduler->getAlgorithmName() << " " << head << " " << seq << " " << completed << " " << totalMovement << " " << busyTime << " " << totalQueueTime << " ";
+        DiskLOOK* look = dynamic_cast<DiskLOOK*>(scheduler);
+        out << (look != nullptr ? look->direction : 1) << "\n";
+        vector<IORequest*> pending = scheduler->getPendingRequests();
+        if (active != nullptr) {
+            pending.insert(pending.begin(), active);
+        }
+        out << (active != nullptr ? 1 : 0) << " " << pending.size() << "\n";
+        for (IORequest* r : pending) {
+            out << r->process->id << " " << r->track << " " << r->transferTime << " " << r->submitTime << " " << r->seq << "\n";
+        }
+    }
+
+    void load(istream& in, map<int, Process*>& processes) {
+        int direction, hasActive, count;
+        in >> head >> seq >> completed >> totalMovement >> busyTime >> totalQueueTime >> direction >> hasActive >> count;
+        DiskLOOK* look = dynamic_cast<DiskLOOK*>(scheduler);
+        if (look != nullptr) {
+            look->direction = direction;
+        }
+        for (int i = 0; i < count; i++) {
+            int id, track, transfer, submit;
+            long rseq;
+            in >> id >> track >> transfer >> submit >> rseq;
+            IORequest* r = new IORequest(processes[id], track, transfer, submit, rseq);
+            if (i == 0 && hasActive) {
+                active = r;
+            } else {
+                scheduler->addRequest(r);
+            }
+        }
+    }
+
+    void print() {
+        printf("DISK: %s %ld %ld %.2lf %.2lf\n", scheduler->getAlgorithmName().c_str(), completed, totalMovement,
+            (busyTime * 100.0) / (double) LAST_EVENT_TIME, completed > 0 ? totalQueueTime / (double) completed : 0.0);
+    }
+};
+
+Disk* DISK = nullptr;
+
+DiskScheduler* getDiskScheduler(char algo) {
+    switch (algo) {
+        case 'S': return new DiskSSTF;
+        case 'L': return new DiskLOOK;
+        default: return new DiskFIFO;
+    }
+}
+
+// Read-only mapping of a whole input file, the loaders parse straight out of the page cache
+class MappedFile {
+    public:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+
+    MappedFile(const string& fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            opened = true;
+            size = st.st_size;
+            if (size > 0) {
+                void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr == MAP_FAILED) {
+                    opened = false;
+                    size = 0;
+                } else {
+                    madvise(addr, size, MADV_SEQUENTIAL);
+                    data = (const char*) addr;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (data != nullptr) {
+            munmap((void*) data, size);
+        }
+    }
+};
+
+// from_chars-style integer parse, leaves pos after the last digit, returns false at end of line or input
+bool parseInt(const char* data, size_t size, size_t& pos, int& value) {
+    while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r')) {
+        pos++;
+    }
+    if (pos >= size || data[pos] == '\n') {
+        return false;
+    }
+    bool negative = data[pos] == '-';
+    if (negative || data[pos] == '+') {
+        pos++;
+    }
+    int v = 0;
+    while (pos < size && (unsigned) (data[pos] - '0') < 10) {
+        v = v * 10 + (data[pos] - '0');
+        pos++;
+    }
+    // like atoi, anything after the digits up to the next blank is ignored
+    while (pos < size && data[pos] != ' ' && data[pos] != '\t' && data[pos] != '\r' && data[pos] != '\n') {
+        pos++;
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+class ProcessReader {
+    private:
+    MappedFile inputFile;
+    size_t pos = 0;
+    int nextId = 0, lastArrival = 0;
+
+    public:
+    ProcessReader(string fileName): inputFile(fileName) {}
+
+    bool isOpen() {
+        return inputFile.opened;
+    }
+
+    // number of processes in the file, read once up front so priorities can be drawn exactly as if
+    // every process had been loaded before the simulation started
+    int countProcesses() {
+        int count = 0;
+        bool blank = true;
+        for (size_t i = 0; i < inputFile.size; i++) {
+            char c = inputFile.data[i];
+            if (c == '\n') {
+                count = count + (blank ? 0 : 1);
+                blank = true;
+            } else if (c != ' ' && c != '\t' && c != '\r') {
+                blank = false;
+            }
+        }
+        return count + (blank ? 0 : 1);
+    }
+
+    Process* readNext() {
+        while (pos < inputFile.size) {
             int tokens[4];
-            stringstream ss(line);
-            string token;
             int c = 0;
-            while (ss >> token) {
-                tokens[c++] = atoi(token.c_str());
+            while (c < 4 && parseInt(inputFile.data, inputFile.size, pos, tokens[c])) {
+                c++;
             }
-            Process* p = new Process(id, tokens[0], tokens[1], tokens[2], tokens[3], getRandomNumber(MAX_PRIO), CREATED);
-            processList.push_back(p);
-            Event* evt = new Event(p->arrivalTime, p, TRANS_TO_READY);
-            des.putEvent(evt);
-            id++;
+            const char* eol = (const char*) memchr(inputFile.data + pos, '\n', inputFile.size - pos);
+            pos = eol == nullptr ? inputFile.size : eol - inputFile.data + 1;
+            if (c == 0) {
+                continue;
+            }
+            if (tokens[0] < lastArrival) {
+                cerr << "Process " << nextId << " arrives before process " << nextId - 1 << ", input must be sorted by arrival time" << endl;
+                exit(1);
+            }
+            lastArrival = tokens[0];
+            int prio = 1 + (randvals[nextId % RAND_LIMIT] % MAX_PRIO);
+            return new Process(nextId++, tokens[0], tokens[1], tokens[2], tokens[3], prio, CREATED);
         }
-        inputFile.close();
+        return nullptr;
+    }
+
+    void save(ostream& out) {
+        out << nextId << " " << lastArrival << " " << pos << "\n";
+    }
+
+    void load(istream& in) {
+        in >> nextId >> lastArrival >> pos;
+    }
+};
+
+ProcessReader* PROCESS_READER = nullptr;
+
+// queues the arrival of the next process from the input, only one arrival is ever pending in the DES
+void injectNextArrival(DES* des) {
+    Process* p = PROCESS_READER->readNext();
+    if (p == nullptr) {
+        return;
+    }
+    if (STREAM_STATS) {
+        liveProcesses[p->id] = p;
+    } else {
+        processList.push_back(p);
+    }
+    des->putArrivalEvent(new Event(p->arrivalTime, p, TRANS_TO_READY));
+}
+
+void readInputFile(string fileName, DES& des) {
+    PROCESS_READER = new ProcessReader(fileName);
+    if (PROCESS_READER->isOpen() && RESUME_FILE != "") {
+        return; // position, counters and pending arrival come from the checkpoint
+    }
+    if (PROCESS_READER->isOpen()) {
+        PROCESS_COUNT = PROCESS_READER->countProcesses();
+        RAND_OFFSET = PROCESS_COUNT % RAND_LIMIT;
+        injectNextArrival(&des);
     } else {
         cout << "Unable to open file " << fileName << endl;
     }
 }
 
+// header of the binary rfile cache (-b), the int values follow it directly
+struct RandCacheHeader {
+    char magic[8];
+    long long sourceSize, sourceMtime;
+    int limit, count;
+};
+
+const char RAND_CACHE_MAGIC[8] = {'R', 'A', 'N', 'D', 'V', 'A', 'L', '1'};
+MappedFile* RAND_CACHE_FILE = nullptr;
+
+// maps <rfile>.bin if it was built from the current rfile, no parsing needed
+bool mapRandomValuesCache(string fileName) {
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0) {
+        return false;
+    }
+    MappedFile* cache = new MappedFile(fileName + ".bin");
+    RandCacheHeader* header = (RandCacheHeader*) cache->data;
+    if (cache->size < sizeof(RandCacheHeader) || memcmp(header->magic, RAND_CACHE_MAGIC, sizeof(RAND_CACHE_MAGIC)) != 0
+            || header->sourceSize != st.st_size || header->sourceMtime != st.st_mtime
+            || cache->size != sizeof(RandCacheHeader) + header->count * sizeof(int)) {
+        delete cache;
+        return false;
+    }
+    RAND_CACHE_FILE = cache;
+    RAND_LIMIT = header->limit;
+    randvals = (const int*) (cache->data + sizeof(RandCacheHeader));
+    return true;
+}
+
+void writeRandomValuesCache(string fileName) {
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0) {
+        return;
+    }
+    RandCacheHeader header;
+    memcpy(header.magic, RAND_CACHE_MAGIC, sizeof(RAND_CACHE_MAGIC));
+    header.sourceSize = st.st_size;
+    header.sourceMtime = st.st_mtime;
+    header.limit = RAND_LIMIT;
+    header.count = randStorage.size();
+    ofstream out(fileName + ".bin", ios::binary);
+    out.write((const char*) &header, sizeof(header));
+    out.write((const char*) randStorage.data(), randStorage.size() * sizeof(int));
+}
+
 void readRandomValuesFile(string fileName) {
-    ifstream inputFile(fileName);
-    bool firstLine = true;
-    if (inputFile.is_open()) {
-        string line;
-        while (getline(inputFile, line)) {
-            int val = atoi(line.c_str());
-            if (firstLine) {
-                firstLine = false;
-                RAND_LIMIT = val;
+    if (RAND_CACHE && mapRandomValuesCache(fileName)) {
+        return;
+    }
+    MappedFile inputFile(fileName);
+    if (inputFile.opened) {
+        size_t pos = 0;
+        int val;
+        bool firstLine = true;
+        while (pos < inputFile.size) {
+            if (parseInt(inputFile.data, inputFile.size, pos, val)) {
+                if (firstLine) {
+                    firstLine = false;
+                    RAND_LIMIT = val;
+                    randStorage.reserve(max(val, 0));
+                } else {
+                    randStorage.push_back(val);
+                }
             } else {
-                randvals.push_back(val);
+                pos++;
             }
         }
-        inputFile.close();
+        randvals = randStorage.data();
+        if (RAND_CACHE) {
+            writeRandomValuesCache(fileName);
+        }
     } else {
         cout << "Unable to open file " << fileName << endl;
     }
 }
 
+string getId(int pid, int limit) {
+    string instr = to_string(pid);
+    int len = instr.length();
+    string prefix = "";
+    for (int i = 0; i < limit - len; i++) {
+        prefix.append("0");
+    }
+    return prefix.append(instr);
+}
+
+template<typename T> void printElement(T t, const int& width) {
+    cout << right << setw(width) << setfill(' ') << t;
+}
+
+void printProcessStats(Process* p) {
+    cout << getId(p->id, 4) << ": ";
+    printElement(p->arrivalTime, 4); cout << " "; printElement(p->totalCpuTime, 4); cout << " "; printElement(p->cpuBurst, 4); cout << " ";
+    printElement(p->ioBurst, 4); cout << " "; printElement(p->staticPriority, 1);
+    cout << " | ";
+    printElement(p->completedTime, 5); cout << " "; printElement(p->completedTime - p->arrivalTime, 5); cout << " "; 
+    printElement(p->ioTime, 5); cout << " "; printElement(p->waitTime, 5);
+    cout << endl;
+    TOTAL_TURNAROUND = TOTAL_TURNAROUND + p->completedTime - p->arrivalTime;
+    TOTAL_WAIT = TOTAL_WAIT + p->waitTime;
+}
+
+const char* CHECKPOINT_MAGIC = "SCHEDCKPT2";
+
+void saveProcess(ostream& out, Process* p) {
+    out << p->id << " " << p->arrivalTime << " " << p->totalCpuTime << " " << p->cpuBurst << " " << p->ioBurst << " " << p->staticPriority << " "
+        << p->dynamicPriority << " " << p->stateTs << " " << p->waitTime << " " << p->ioTime << " " << p->remainingTime << " " << p->quantumTime << " "
+        << p->completedTime << " " << p->cpuAccounted << " " << p->vruntime << " " << p->processState << "\n";
+}
+
+Process* loadProcess(istream& in) {
+    int id, arrivalTime, totalCpuTime, cpuBurst, ioBurst, staticPriority, state;
+    in >> id >> arrivalTime >> totalCpuTime >> cpuBurst >> ioBurst >> staticPriority;
+    Process* p = new Process(id, arrivalTime, totalCpuTime, cpuBurst, ioBurst, staticPriority, CREATED);
+    in >> p->dynamicPriority >> p->stateTs >> p->waitTime >> p->ioTime >> p->remainingTime >> p->quantumTime >> p->completedTime >> p->cpuAccounted
+        >> p->vruntime >> state;
+    p->processState = (ProcessState) state;
+    return p;
+}
+
+string getAlgorithmFamily(Scheduler* scheduler) {
+    string name = scheduler->getAlgorithmName();
+    return name.substr(0, name.find(' '));
+}
+
+// Snapshot of everything the event loop carries between two events: global counters, the random
+// offset, live processes, pending events, the scheduler's queues and the position in the input file.
+// Any number of runs can resume from it with the same scheduler family and different parameters.
+void writeCheckpoint(Scheduler* scheduler, DES* des) {
+    ofstream out(CHECKPOINT_FILE);
+    if (! out.is_open()) {
+        cout << "Unable to open file " << CHECKPOINT_FILE << endl;
+        return;
+    }
+    out << CHECKPOINT_MAGIC << " " << getAlgorithmFamily(scheduler) << "\n";
+    out << RAND_OFFSET << " " << LAST_EVENT_TIME << " " << IO_TIME << " " << CPU_TIME << " " << PREVIOUS_TIMESTAMP << " " << IO_PROCESS_COUNT << " "
+        << PROCESS_COUNT << " " << (long long) TOTAL_TURNAROUND << " " << (long long) TOTAL_WAIT << " " << (CURRENT_RUNNING_PROCESS != nullptr ? CURRENT_RUNNING_PROCESS->id : -1) << "\n";
+    PROCESS_READER->save(out);
+    if (STREAM_STATS) {
+        out << liveProcesses.size() << "\n";
+        for (auto it = liveProcesses.begin(); it != liveProcesses.end(); ++it) {
+            saveProcess(out, it->second);
+        }
+    } else {
+        out << processList.size() << "\n";
+        for (Process* p : processList) {
+            saveProcess(out, p);
+        }
+    }
+    out << des->evtList.size() << "\n";
+    for (Event* evt : des->evtList) {
+        out << evt->timestamp << " " << evt->process->id << " " << evt->transition << "\n";
+    }
+    scheduler->save(out);
+    if (DISK != nullptr) {
+        DISK->save(out);
+    } else {
+        out << "-\n";
+    }
+    // the windows and histograms so far, so a resumed -m run reports the whole run
+    if (METRICS != nullptr) {
+        out << "M ";
+        METRICS->save(out);
+    } else {
+        out << "-\n";
+    }
+    out.close();
+    CHECKPOINT_TIME = -1;
+}
+
+bool readCheckpoint(Scheduler* scheduler, DES& des) {
+    ifstream in(RESUME_FILE);
+    if (! in.is_open()) {
+        cout << "Unable to open file " << RESUME_FILE << endl;
+        return false;
+    }
+    string magic, family;
+    in >> magic >> family;
+    if (magic != CHECKPOINT_MAGIC || family != getAlgorithmFamily(scheduler)) {
+        cout << "Checkpoint " << RESUME_FILE << " was not taken with a " << getAlgorithmFamily(scheduler) << " scheduler" << endl;
+        return false;
+    }
+    int runningId, count;
+    in >> RAND_OFFSET >> LAST_EVENT_TIME >> IO_TIME >> CPU_TIME >> PREVIOUS_TIMESTAMP >> IO_PROCESS_COUNT >> PROCESS_COUNT >> TOTAL_TURNAROUND >> TOTAL_WAIT >> runningId;
+    PROCESS_READER->load(in);
+    map<int, Process*> processes;
+    in >> count;
+    for (int i = 0; i < count; i++) {
+        Process* p = loadProcess(in);
+        processes[p->id] = p;
+        if (STREAM_STATS) {
+            liveProcesses[p->id] = p;
+        } else {
+            processList.push_back(p);
+        }
+    }
+    CURRENT_RUNNING_PROCESS = runningId < 0 ? nullptr : processes[runningId];
+    in >> count;
+    for (int i = 0; i < count; i++) {
+        int ts, id, transition;
+        in >> ts >> id >> transition;
+        des.evtList.push_back(new Event(ts, processes[id], (TransitionState) transition));
+    }
+    scheduler->load(in, processes);
+    string disk;
+    in >> disk;
+    if (disk != (DISK != nullptr ? DISK->scheduler->getAlgorithmName() : "-")) {
+        cout << "Checkpoint " << RESUME_FILE << " was not taken with the same disk model" << endl;
+        return false;
+    }
+    if (DISK != nullptr) {
+        DISK->load(in, processes);
+    }
+    string metrics;
+    int window = 0;
+    in >> metrics;
+    if (metrics == "M") {
+        in >> window;
+    }
+    if (METRICS != nullptr) {
+        if (window != METRICS->window) {
+            cout << "Checkpoint " << RESUME_FILE << " was not taken with -m" << METRICS->window << endl;
+            return false;
+        }
+        METRICS->load(in);
+    }
+    return true;
+}
+
 bool processEvent(DES* des) {
     PROCESS_EVT = des->getEvent();
     return PROCESS_EVT != nullptr;
 }
 
-void Simulation(Scheduler* scheduler, DES* des) {
-    while (processEvent(des)) {
+template<typename S, typename Trace> void Simulation(S* scheduler, DES* des) {
+    while (true) {
+        if (CHECKPOINT_TIME >= 0 && des->getNextEventTime() >= CHECKPOINT_TIME) {
+            writeCheckpoint(scheduler, des);
+        }
+        if (! processEvent(des)) {
+            break;
+        }
         Process* process = PROCESS_EVT->process;
         int currentTime = PROCESS_EVT->timestamp;
         TransitionState transition = PROCESS_EVT->transition;
@@ -420,21 +1392,28 @@ void Simulation(Scheduler* scheduler, DES* des) {
         
         if (IO_PROCESS_COUNT > 0) {
             IO_TIME = IO_TIME + (currentTime - PREVIOUS_TIMESTAMP);
+            if (METRICS != nullptr) METRICS->addBusy(METRICS->ioBusy, PREVIOUS_TIMESTAMP, currentTime);
         }
         if (CURRENT_RUNNING_PROCESS != nullptr) {
             CPU_TIME = CPU_TIME + (currentTime - PREVIOUS_TIMESTAMP);
+            if (METRICS != nullptr) METRICS->addBusy(METRICS->cpuBusy, PREVIOUS_TIMESTAMP, currentTime);
         }
         bool callScheduler = false;
         PREVIOUS_TIMESTAMP = currentTime;
         switch(transition) {
             case TRANS_TO_READY: {
-                if (VERBOSE) printf("%d %d %d: %s -> %s\n", currentTime, process->id, timeInPrevState, ProcessStateText[process->processState], "READY");
-                if (process->processState == BLOCKED) {
+                if (Trace::ENABLED) printf("%d %d %d: %s -> %s\n", currentTime, process->id, timeInPrevState, ProcessStateText[process->processState], "READY");
+                if (process->processState == CREATED) {
+                    injectNextArrival(des);
+                } else if (process->processState == BLOCKED) {
+                    if (DISK != nullptr) {
+                        DISK->complete(des, currentTime);
+                    }
                     IO_PROCESS_COUNT--;
                     process->ioTime = process->ioTime + timeInPrevState;
                     process->dynamicPriority = process->staticPriority - 1;
                 }
-                if (scheduler->doesPreempt() && CURRENT_RUNNING_PROCESS != nullptr && process->dynamicPriority > CURRENT_RUNNING_PROCESS->dynamicPriority) {
+                if (scheduler->doesPreempt() && CURRENT_RUNNING_PROCESS != nullptr && scheduler->preempts(process, CURRENT_RUNNING_PROCESS, currentTime)) {
                     bool removed = des->removeEvent(currentTime, CURRENT_RUNNING_PROCESS, TRANS_TO_PREEMPT);
                     removed = removed || des->removeEvent(currentTime, CURRENT_RUNNING_PROCESS, TRANS_TO_BLOCK);
                     removed = removed || des->removeEvent(currentTime, CURRENT_RUNNING_PROCESS, TRANS_TO_COMPLETE);
@@ -453,11 +1432,13 @@ void Simulation(Scheduler* scheduler, DES* des) {
                     runTime = min(process->remainingTime, getRandomNumber(process->cpuBurst));
                     process->quantumTime = runTime;
                 }
-                if (VERBOSE) printf("%d %d %d: %s -> %s cb=%d rem=%d prio=%d\n", currentTime, process->id, timeInPrevState, ProcessStateText[process->processState], "RUNNG", runTime, process->remainingTime, process->dynamicPriority);
+                if (Trace::ENABLED) printf("%d %d %d: %s -> %s cb=%d rem=%d prio=%d\n", currentTime, process->id, timeInPrevState, ProcessStateText[process->processState], "RUNNG", runTime, process->remainingTime, process->dynamicPriority);
                 process->processState =  RUNNING; process->stateTs = currentTime;
                 process->waitTime = process->waitTime + timeInPrevState;
-                if (QUANTUM < process->quantumTime) {
-                    Event* evt = new Event(currentTime + QUANTUM, process, TRANS_TO_PREEMPT);
+                if (METRICS != nullptr) METRICS->queueDelay.record(timeInPrevState);
+                int quantum = scheduler->getTimeSlice(process);
+                if (quantum < process->quantumTime) {
+                    Event* evt = new Event(currentTime + quantum, process, TRANS_TO_PREEMPT);
                     des->putEvent(evt);
                 } else if (runTime == process->remainingTime) {
                     Event* evt = new Event(currentTime + runTime, process, TRANS_TO_COMPLETE);
@@ -473,17 +1454,23 @@ void Simulation(Scheduler* scheduler, DES* des) {
                 CURRENT_RUNNING_PROCESS = nullptr;
                 int runTime = getRandomNumber(process->ioBurst);
                 process->remainingTime = process->remainingTime - timeInPrevState; process->quantumTime = process->quantumTime - timeInPrevState;
-                if (VERBOSE) printf("%d %d %d: %s -> %s  ib=%d rem=%d\n", currentTime, process->id, timeInPrevState, ProcessStateText[process->processState], "BLOCK", runTime, process->remainingTime);
+                if (Trace::ENABLED) printf("%d %d %d: %s -> %s  ib=%d rem=%d\n", currentTime, process->id, timeInPrevState, ProcessStateText[process->processState], "BLOCK", runTime, process->remainingTime);
                 process->processState =  BLOCKED; process->stateTs = currentTime;
-                Event* evt = new Event(currentTime + runTime, process, TRANS_TO_READY);
-                des->putEvent(evt);
+                if (DISK != nullptr) {
+                    DISK->submit(process, runTime, des, currentTime);
+                } else {
+                    Event* evt = new Event(currentTime + runTime, process, TRANS_TO_READY);
+                    des->putEvent(evt);
+                }
                 callScheduler = true;
                 break;
             }
             case TRANS_TO_PREEMPT: {
                 process->remainingTime = process->remainingTime - timeInPrevState; process->quantumTime = process->quantumTime - timeInPrevState;
-                if (VERBOSE) printf("%d %d %d: %s -> %s  cb=%d rem=%d prio=%d\n", currentTime, process->id, timeInPrevState, ProcessStateText[process->processState], "READY", process->quantumTime, process->remainingTime, process->dynamicPriority);
-                process->dynamicPriority = process->dynamicPriority - 1;
+                if (Trace::ENABLED) printf("%d %d %d: %s -> %s  cb=%d rem=%d prio=%d\n", currentTime, process->id, timeInPrevState, ProcessStateText[process->processState], "READY", process->quantumTime, process->remainingTime, process->dynamicPriority);
+                if (scheduler->decaysPriority()) {
+                    process->dynamicPriority = process->dynamicPriority - 1;
+                }
                 CURRENT_RUNNING_PROCESS = nullptr;
                 process->processState =  READY; process->stateTs = currentTime;
                 scheduler->addProcess(process);
@@ -491,13 +1478,23 @@ void Simulation(Scheduler* scheduler, DES* des) {
                 break;
             }
             case TRANS_TO_COMPLETE: {
-                if (VERBOSE) printf("%d %d %d: %s\n", currentTime, process->id, timeInPrevState, "Done");
+                if (Trace::ENABLED) printf("%d %d %d: %s\n", currentTime, process->id, timeInPrevState, "Done");
                 CURRENT_RUNNING_PROCESS = nullptr;
                 process->processState =  COMPLETED; process->completedTime = currentTime;
                 LAST_EVENT_TIME = currentTime;
+                if (METRICS != nullptr) {
+                    METRICS->waitTime.record(process->waitTime);
+                    METRICS->turnaround.record(process->completedTime - process->arrivalTime);
+                }
+                if (STREAM_STATS) {
+                    printProcessStats(process);
+                    liveProcesses.erase(process->id);
+                    delete process;
+                }
                 callScheduler = true;
             }
         }
+        delete PROCESS_EVT;
 
         if (callScheduler) {
             if (des->getNextEventTime() == currentTime)
@@ -513,37 +1510,29 @@ void Simulation(Scheduler* scheduler, DES* des) {
     }
 }
 
-string getId(int pid, int limit) {
-    string instr = to_string(pid);
-    int len = instr.length();
-    string prefix = "";
-    for (int i = 0; i < limit - len; i++) {
-        prefix.append("0");
+template<typename S> void SchedulerImpl<S>::simulate(DES* des) {
+    if (VERBOSE) {
+        Simulation<S, VerboseTrace>(static_cast<S*>(this), des);
+    } else {
+        Simulation<S, NoTrace>(static_cast<S*>(this), des);
     }
-    return prefix.append(instr);
-}
-
-template<typename T> void printElement(T t, const int& width) {
-    cout << right << setw(width) << setfill(' ') << t;
 }
 
 void printStats(Scheduler* scheduler) {
-    cout << scheduler->getAlgorithmName() << endl;
-    double cpuUtil = 0.0, ioUtil = 0.0, avgTurn = 0.0, avgWait = 0.0;
-    for (Process* p : processList) {
-        cout << getId(p->id, 4) << ": ";
-        printElement(p->arrivalTime, 4); cout << " "; printElement(p->totalCpuTime, 4); cout << " "; printElement(p->cpuBurst, 4); cout << " ";
-        printElement(p->ioBurst, 4); cout << " "; printElement(p->staticPriority, 1);
-        cout << " | ";
-        printElement(p->completedTime, 5); cout << " "; printElement(p->completedTime - p->arrivalTime, 5); cout << " "; 
-        printElement(p->ioTime, 5); cout << " "; printElement(p->waitTime, 5);
-        cout << endl;
-        ioUtil = ioUtil + p->ioTime;
-        avgTurn = avgTurn + p->completedTime - p->arrivalTime;
-        avgWait = avgWait + p->waitTime;
+    if (! STREAM_STATS) {
+        cout << scheduler->getAlgorithmName() << endl;
+        for (Process* p : processList) {
+            printProcessStats(p);
+        }
     }
     printf("SUM: %d %.2lf %.2lf %.2lf %.2lf %.3lf\n", LAST_EVENT_TIME, (CPU_TIME * 100.0) / (double) LAST_EVENT_TIME, (IO_TIME * 100.0) / (double) LAST_EVENT_TIME, 
-        avgTurn / processList.size(), avgWait / processList.size(), (processList.size() * 100.0) / (double) LAST_EVENT_TIME);
+        TOTAL_TURNAROUND / PROCESS_COUNT, TOTAL_WAIT / PROCESS_COUNT, (PROCESS_COUNT * 100.0) / (double) LAST_EVENT_TIME);
+    if (DISK != nullptr) {
+        DISK->print();
+    }
+    if (METRICS != nullptr) {
+        METRICS->print();
+    }
 }
 
 Scheduler* getSchedulingAlgorithm(string& param) {
@@ -567,6 +1556,8 @@ Scheduler* getSchedulingAlgorithm(string& param) {
         return new RR;
     } else if (algo == 'P') {
         return new PRIO(MAX_PRIO);
+    } else if (algo == 'C') {
+        return new CFS(n >= 2 ? quantum : 48, MAX_PRIO);
     } else {
         return new PREPRIO(MAX_PRIO);
     }
@@ -574,11 +1565,39 @@ Scheduler* getSchedulingAlgorithm(string& param) {
 
 void readArguments(int argc, char** argv) {
     int opt;
-    while ((opt = getopt (argc, argv, "vtepis:")) != -1) {
+    while ((opt = getopt (argc, argv, "vtepilbc:r:m:d:s:")) != -1) {
         switch (opt) {
             case 'v': 
                 VERBOSE = true;
                 break;
+            case 'l':
+                STREAM_STATS = true;
+                break;
+            case 'b':
+                RAND_CACHE = true;
+                break;
+            case 'c': {
+                // -c<time>:<file> writes a checkpoint before the first event at or after <time>
+                const char* sep = strchr(optarg, ':');
+                if (sep != nullptr) {
+                    CHECKPOINT_TIME = atoi(optarg);
+                    CHECKPOINT_FILE = sep + 1;
+                }
+                break;
+            }
+            case 'r':
+                RESUME_FILE = optarg;
+                break;
+            case 'm':
+                METRICS = new SimulationMetrics(max(1, atoi(optarg)));
+                break;
+            case 'd': {
+                char algo = 'N';
+                int tracks = 100;
+                sscanf(optarg, "%c:%d", &algo, &tracks);
+                DISK = new Disk(getDiskScheduler(algo), max(1, tracks));
+                break;
+            }
             case 's':
                 SCHEDULING_ALGO_PARAM = optarg;
                 break;
@@ -603,7 +1622,13 @@ int main(int argc, char** argv) {
         Scheduler* scheduler = getSchedulingAlgorithm(SCHEDULING_ALGO_PARAM);
         readRandomValuesFile(RAND_FILE);
         readInputFile(INPUT_FILE, des);
-        Simulation(scheduler, &des);
+        if (RESUME_FILE != "" && ! readCheckpoint(scheduler, des)) {
+            return 1;
+        }
+        if (STREAM_STATS) {
+            cout << scheduler->getAlgorithmName() << endl;
+        }
+        scheduler->simulate(&des);
         printStats(scheduler);
     } catch (...) {
         cout << "Default Error" << endl;
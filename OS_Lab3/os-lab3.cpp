@@ -1,4 +1,8 @@
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -7,33 +11,111 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <queue>
 #include <stack>
 #include <iomanip>
+#include <climits>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <atomic>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
+// pages shown by the page table printouts, the address space itself is PageTable::MAX_VPAGES
 const int PAGE_TABLE_SIZE = 64;
-int FRAME_TABLE_SIZE = 128;
-enum PageOperation { READ, WRITE, CONTEXT_SWITCH, EXIT, MAP, UNMAP, IN, OUT, FIN, FOUT, ZERO, SEGV, SEGPROT };
-const char* PageOperationText[] = {"READ", "WRITE", "CONTEXT_SWITCH", "EXIT", "MAP", "UNMAP", "IN", "OUT", "FIN", "FOUT", "ZERO", "SEGV", "SEGPROT"};
-map<int, int> instrCostMap = { {WRITE, 1}, {READ, 1}, {CONTEXT_SWITCH, 130}, {EXIT, 1230}, {MAP, 350}, {UNMAP, 410}, {IN, 3200}, {OUT, 2750}, {FIN, 2350}, 
-                        {FOUT, 2800}, {ZERO, 150}, {SEGV, 440}, {SEGPROT, 410} };
+// the width of PTE::frame
+const int MAX_FRAME_TABLE_SIZE = 1 << 24;
+thread_local int FRAME_TABLE_SIZE = 128;
+// the frames are split evenly into nodes in frame order, process i lives on node i % NUMA_NODES
+int NUMA_NODES = 1;
+// pages per huge page, a power of two, 0 when huge pages are off (-H), and its order for the buddy allocator.
+// Only VMAs flagged in the input are eligible unless HUGE_ALWAYS
+int HUGE_PAGE_SIZE = 0, HUGE_ORDER = 0;
+bool HUGE_ALWAYS = false;
+enum PageOperation { READ, WRITE, CONTEXT_SWITCH, EXIT, MAP, UNMAP, IN, OUT, FIN, FOUT, ZERO, SEGV, SEGPROT, TLBMISS, PAGEWALK, READAHEAD, ZSTORE, ZLOAD, COW,
+    RACCESS, RFAULT, MIGRATE, SPLIT };
+const char* PageOperationText[] = {"READ", "WRITE", "CONTEXT_SWITCH", "EXIT", "MAP", "UNMAP", "IN", "OUT", "FIN", "FOUT", "ZERO", "SEGV", "SEGPROT", "TLBMISS", "PAGEWALK", "READAHEAD", "ZSTORE", "ZLOAD", "COW",
+    "RACCESS", "RFAULT", "MIGRATE", "SPLIT"};
+// TLBMISS and PAGEWALK are only charged when a TLB is simulated (-t), READAHEAD is the batched I/O per prefetched page (-p),
+// ZSTORE and ZLOAD compress into and decompress from the swap pool (-z), COW copies a shared page on write,
+// RACCESS is the extra for a reference to another NUMA node, RFAULT for a fault filled there and MIGRATE moves a page home (-n),
+// SPLIT breaks a huge page up into base pages (-H)
+// indexed by PageOperation
+constexpr int instrCostMap[] = { 1, 1, 130, 1230, 350, 410, 3200, 2750, 2350, 2800, 150, 440, 410, 5, 20, 300, 300, 250, 300, 2, 100, 450, 200 };
+static_assert(sizeof(instrCostMap) / sizeof(instrCostMap[0]) == SPLIT + 1, "one cost per PageOperation");
+
+// The per-instruction printouts write through this straight into stdout's buffer, which main() enlarges,
+// without the formatting and sync overhead of cout. cout and printf use the same buffer, so order is kept.
+class OutputWriter {
+    public:
+    OutputWriter& operator<<(const char* text) {
+        fputs_unlocked(text, stdout);
+        return *this;
+    }
+
+    OutputWriter& operator<<(const string& text) {
+        fwrite_unlocked(text.data(), 1, text.size(), stdout);
+        return *this;
+    }
+
+    OutputWriter& operator<<(char c) {
+        putc_unlocked(c, stdout);
+        return *this;
+    }
+
+    OutputWriter& operator<<(long long value) {
+        char digits[24];
+        int n = 0;
+        unsigned long long rest = value < 0 ? -(unsigned long long) value : value;
+        do {
+            digits[n++] = '0' + rest % 10;
+            rest = rest / 10;
+        } while (rest > 0);
+        if (value < 0) {
+            putc_unlocked('-', stdout);
+        }
+        while (n > 0) {
+            putc_unlocked(digits[--n], stdout);
+        }
+        return *this;
+    }
+
+    OutputWriter& operator<<(int value) { return *this << (long long) value; }
+    OutputWriter& operator<<(long value) { return *this << (long long) value; }
+    OutputWriter& operator<<(unsigned long value) { return *this << (long long) value; }
+};
+
+OutputWriter writer;
 
 template<typename T> void printElement(T t, const int& width) {
-    cout << right << setw(width) << setfill(' ') << t;
+    string text = to_string(t);
+    writer << string(max(0, width - (int) text.size()), ' ') << text;
 }
 
 class VMA {
     public:
-    int startVPage, endVPage, writeProtected, fileMapped; 
+    long startVPage, endVPage;
+    int writeProtected, fileMapped; 
+    // file-mapped VMAs naming the same object share its resident pages, a private one copies a page on write
+    int object, privateMapping;
+    // may be mapped with huge pages (-H)
+    int hugePage;
 
-    VMA(int startVP, int endVP, int writePr, int fileMp): startVPage(startVP), endVPage(endVP), writeProtected(writePr), fileMapped(fileMp) {}
+    VMA(long startVP, long endVP, int writePr, int fileMp, int obj = -1, int priv = 0, int huge = 0): startVPage(startVP), endVPage(endVP),
+        writeProtected(writePr), fileMapped(fileMp), object(obj), privateMapping(priv), hugePage(huge) {}
+
+    // laid out like getPageKey(), the object in place of the pid
+    long long getObjectKey(long vpage);
 };
 
 struct PTE {
-    unsigned int frame: 7;
+    unsigned int frame: 24;
     unsigned int present: 1;
     unsigned int referenced: 1;
     unsigned int modified: 1;
@@ -41,80 +123,430 @@ struct PTE {
     unsigned int pagedOut: 1;
     unsigned int fileMapped: 1;
     unsigned int existsVma: 1;
+    unsigned int vmaChecked: 1;
 
-    PTE() : frame(0), present(0), referenced(0), modified(0), writeProtected(0), pagedOut(0), fileMapped(0), existsVma(0) {}
+    PTE() : frame(0), present(0), referenced(0), modified(0), writeProtected(0), pagedOut(0), fileMapped(0), existsVma(0), vmaChecked(0) {}
 } pack;
 
+// Four-level radix page table with 9 bits per level, as on x86-64, so a process can address 2^36 pages
+// (48-bit virtual addresses with 4K pages). Levels are allocated on first use, so memory follows the
+// pages that were actually touched rather than the size of the address space.
+class PageTable {
+    public:
+    static const int LEVEL_BITS = 9, LEVELS = 4, FANOUT = 1 << LEVEL_BITS;
+    static const int VPAGE_BITS = LEVEL_BITS * LEVELS;
+
+    private:
+    struct Leaf {
+        PTE ptes[FANOUT];
+    };
+
+    struct Level {
+        void* entries[FANOUT];
+
+        Level() {
+            memset(entries, 0, sizeof(entries));
+        }
+    };
+
+    Level* root = nullptr;
+    // the last leaf used, consecutive references mostly land in the same 512-page block
+    long cachedLeafIndex = -1;
+    Leaf* cachedLeaf = nullptr;
+
+    Leaf* findLeaf(long leafIndex, bool allocate) {
+        if (root == nullptr) {
+            if (! allocate) {
+                return nullptr;
+            }
+            root = new Level();
+        }
+        Level* level = root;
+        for (int depth = LEVELS - 1; depth > 0; depth--) {
+            int slot = (leafIndex >> ((depth - 1) * LEVEL_BITS)) & (FANOUT - 1);
+            if (level->entries[slot] == nullptr) {
+                if (! allocate) {
+                    return nullptr;
+                }
+                level->entries[slot] = depth > 1 ? (void*) new Level() : (void*) new Leaf();
+            }
+            if (depth == 1) {
+                return (Leaf*) level->entries[slot];
+            }
+            level = (Level*) level->entries[slot];
+        }
+        return nullptr;
+    }
+
+    template<typename F> void visit(Level* level, int depth, long prefix, F& callback) {
+        for (int slot = 0; slot < FANOUT; slot++) {
+            if (level->entries[slot] == nullptr) {
+                continue;
+            }
+            long index = (prefix << LEVEL_BITS) | slot;
+            if (depth == 1) {
+                Leaf* leaf = (Leaf*) level->entries[slot];
+                for (int i = 0; i < FANOUT; i++) {
+                    callback((index << LEVEL_BITS) | i, &leaf->ptes[i]);
+                }
+            } else {
+                visit((Level*) level->entries[slot], depth - 1, index, callback);
+            }
+        }
+    }
+
+    void release(Level* level, int depth) {
+        for (int slot = 0; slot < FANOUT; slot++) {
+            if (level->entries[slot] != nullptr) {
+                if (depth == 1) {
+                    delete (Leaf*) level->entries[slot];
+                } else {
+                    release((Level*) level->entries[slot], depth - 1);
+                }
+            }
+        }
+        delete level;
+    }
+
+    public:
+    static const long MAX_VPAGES = 1L << VPAGE_BITS;
+
+    // nullptr when the page is outside the address space, or its level was never allocated and allocate is false
+    PTE* getPTE(long vpage, bool allocate = false) {
+        if (vpage < 0 || vpage >= MAX_VPAGES) {
+            return nullptr;
+        }
+        long leafIndex = vpage >> LEVEL_BITS;
+        if (leafIndex != cachedLeafIndex) {
+            Leaf* leaf = findLeaf(leafIndex, allocate);
+            if (leaf == nullptr) {
+                return nullptr;
+            }
+            cachedLeafIndex = leafIndex;
+            cachedLeaf = leaf;
+        }
+        return &cachedLeaf->ptes[vpage & (FANOUT - 1)];
+    }
+
+    // calls callback(vpage, pte) for every entry of every allocated leaf, in vpage order
+    template<typename F> void forEachPTE(F callback) {
+        if (root != nullptr) {
+            visit(root, LEVELS - 1, 0, callback);
+        }
+    }
+
+    void clear() {
+        if (root != nullptr) {
+            release(root, LEVELS - 1);
+        }
+        root = nullptr;
+        cachedLeafIndex = -1;
+        cachedLeaf = nullptr;
+    }
+};
+
 class ProcessStats {
     public:
-    unsigned long unmaps, maps, ins, outs, fins, fouts, zeros, segv, segprot;
+    unsigned long unmaps, maps, ins, outs, fins, fouts, zeros, segv, segprot, tlbHits, tlbMisses, prefetches, prefetchHits, zstores, zloads, shares, cows;
+    unsigned long remoteAccesses, remoteFaults, migrations;
+    // huge pages mapped and split, and faults that were eligible for one but found no free block
+    unsigned long hugeMaps, hugeSplits, hugeFallbacks;
+    // times the process was suspended by the load control of -q
+    unsigned long suspensions;
 
-    ProcessStats(): unmaps(0), maps(0), ins(0), outs(0), fins(0), fouts(0), zeros(0), segv(0), segprot(0) {}
+    ProcessStats(): unmaps(0), maps(0), ins(0), outs(0), fins(0), fouts(0), zeros(0), segv(0), segprot(0), tlbHits(0), tlbMisses(0),
+        prefetches(0), prefetchHits(0), zstores(0), zloads(0), shares(0), cows(0), remoteAccesses(0), remoteFaults(0), migrations(0),
+        hugeMaps(0), hugeSplits(0), hugeFallbacks(0), suspensions(0) {}
 };
 
 class Process {
     public:
     int id;
-    bool loadedBefore;
-    vector<VMA*> vmas;
-    PTE pte[PAGE_TABLE_SIZE];
+    // keyed by startVPage, VMAs of a process do not overlap
+    map<long, VMA*> vmas;
+    PageTable pageTable;
     ProcessStats* pstats;
+    // adaptive readahead: current window and the page a sequential fault would hit next
+    int raWindow = 1;
+    long raNext = -1;
+    int homeNode;
+    // frames whose first mapping is this process's
+    int resident = 0;
 
-    Process(int id, ProcessStats* ps): id(id), loadedBefore(false), pstats(ps) {}
+    Process(int id, ProcessStats* ps): id(id), pstats(ps), homeNode(id % NUMA_NODES) {}
 
     void addVma(VMA* vma) {
-        vmas.push_back(vma);
+        vmas[vma->startVPage] = vma;
     }
 
-    void loadPTEFromVMAs() {
-        for (auto vma = vmas.begin(); vma != vmas.end(); ++vma) {
-            for (int i = (*vma)->startVPage; i <= (*vma)->endVPage; i++) {
-                pte[i].writeProtected = (*vma)->writeProtected;
-                pte[i].fileMapped = (*vma)->fileMapped;
-                pte[i].existsVma = 1;
-            }
+    VMA* findVma(long vpage) {
+        auto it = vmas.upper_bound(vpage);
+        if (it == vmas.begin()) {
+            return nullptr;
+        }
+        --it;
+        return vpage <= it->second->endVPage ? it->second : nullptr;
+    }
+
+    // VMAs are consulted the first time a page faults, nullptr when no VMA covers it
+    PTE* populatePTE(long vpage) {
+        PTE* pte = pageTable.getPTE(vpage);
+        if (pte != nullptr && pte->vmaChecked == 1) {
+            return pte->existsVma == 1 ? pte : nullptr;
         }
+        VMA* vma = findVma(vpage);
+        if (vma == nullptr) {
+            return nullptr;
+        }
+        pte = pageTable.getPTE(vpage, true);
+        if (pte == nullptr) {
+            return nullptr;
+        }
+        pte->writeProtected = vma->writeProtected;
+        pte->fileMapped = vma->fileMapped;
+        pte->existsVma = 1;
+        pte->vmaChecked = 1;
+        return pte;
     }
 };
 
+struct RMapEntry {
+    int processId;
+    long vpage;
+    PTE* pte;
+};
+
 struct FrameEntry {
-    int frameId, processId, pageValue, timeLastUse;
-    unsigned int age;
+    int frameId, processId, timeLastUse;
+    // NUMA node, and references from processes on other nodes since the page was mapped
+    int node;
+    unsigned int remoteRefs;
+    // first frame of the huge page the frame is part of, -1 for a base page
+    int hugeHead;
+    long pageValue;
+    PTE* pte;
     bool isMapped;
+    // brought in by readahead and not referenced yet
+    bool prefetched;
+    // page of a shared object (VMA::getObjectKey) or -1, processId/pageValue/pte is its first mapping and the
+    // reverse map holds the others, sharedDirty keeps the M bit of mappings that went away
+    long long objectKey;
+    vector<RMapEntry> sharers;
+    bool sharedDirty;
+    FrameEntry* lruPrev;
+    FrameEntry* lruNext;
 
-    FrameEntry(int id): frameId(id), age(0), timeLastUse(0), isMapped(false) {}
+    FrameEntry(int id): frameId(id), timeLastUse(0), node(0), remoteRefs(0), hugeHead(-1), pte(nullptr), isMapped(false), prefetched(false), objectKey(-1), sharedDirty(false),
+        lruPrev(nullptr), lruNext(nullptr) {}
 };
 
+// R and M of a frame are those of all PTEs mapping it
+bool isFrameReferenced(FrameEntry* fe) {
+    if (fe->pte->referenced == 1) {
+        return true;
+    }
+    for (auto it = fe->sharers.begin(); it != fe->sharers.end(); ++it) {
+        if (it->pte->referenced == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void clearFrameReferenced(FrameEntry* fe) {
+    fe->pte->referenced = 0;
+    for (auto it = fe->sharers.begin(); it != fe->sharers.end(); ++it) {
+        it->pte->referenced = 0;
+    }
+}
+
+bool isFrameModified(FrameEntry* fe) {
+    if (fe->pte->modified == 1 || fe->sharedDirty) {
+        return true;
+    }
+    for (auto it = fe->sharers.begin(); it != fe->sharers.end(); ++it) {
+        if (it->pte->modified == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void clearFrameModified(FrameEntry* fe) {
+    fe->pte->modified = 0;
+    fe->sharedDirty = false;
+    for (auto it = fe->sharers.begin(); it != fe->sharers.end(); ++it) {
+        it->pte->modified = 0;
+    }
+}
+
+// set once any file-mapped VMA names an object, so traces without sharing skip the object lookups
+bool SHARED_OBJECTS = false;
+// resident pages of shared objects by VMA::getObjectKey()
+thread_local map<long long, FrameEntry*> objectFrames;
+// mappings beyond the first of every shared frame, i.e. frames saved by sharing
+thread_local unsigned long sharedMappings = 0, peakSharedMappings = 0;
+
 class Pager {
     public:
+    virtual ~Pager() {}
+
     virtual void frameSelected(FrameEntry* fte) = 0;
+
+    // may find free frames in the table once the page cleaner (-k) reclaims ahead of demand, so every pager
+    // skips unmapped frames, without the cleaner it is only called with all frames mapped. With local
+    // replacement (-q) only some processes' frames are candidates, see FrameTable::isCandidate()
     virtual FrameEntry* getVictimFrame() = 0;
+
+    // called on every reference to a mapped page, hit or fault
+    virtual void frameReferenced(FrameEntry* fte) {}
+
+    // called for a free frame filled by readahead, which is mapped without being referenced
+    virtual void framePrefetched(FrameEntry* fte) {}
+};
+
+// Binary buddy allocator over the frames [start, end) of one node. A free block of 2^order frames starts at a
+// multiple of its size and merges with its buddy when that is freed too. Single frames are cut from the
+// smallest block there is, which keeps the large ones whole for huge pages.
+class BuddyAllocator {
+    private:
+    int maxOrder;
+    // first frames of the free blocks by order, lowest first
+    vector<set<int>> freeBlocks;
+
+    public:
+    BuddyAllocator(int start, int end, int maxOrder): maxOrder(maxOrder), freeBlocks(maxOrder + 1) {
+        for (int frame = start; frame < end; frame++) {
+            free(frame, 0);
+        }
+    }
+
+    void free(int frame, int order) {
+        // a buddy on the free list lies within the node
+        while (order < maxOrder && freeBlocks[order].erase(frame ^ (1 << order)) == 1) {
+            frame = frame & ~(1 << order);
+            order++;
+        }
+        freeBlocks[order].insert(frame);
+    }
+
+    // first frame of a free block of 2^order frames, -1 when there is none
+    int allocate(int order) {
+        int from = order;
+        while (from <= maxOrder && freeBlocks[from].empty()) {
+            from++;
+        }
+        if (from > maxOrder) {
+            return -1;
+        }
+        int frame = *freeBlocks[from].begin();
+        freeBlocks[from].erase(freeBlocks[from].begin());
+        // the upper halves go back as smaller blocks
+        while (from > order) {
+            from--;
+            freeBlocks[from].insert(frame + (1 << from));
+        }
+        return frame;
+    }
+
+    int getFreeBlocks(int order) { return freeBlocks[order].size(); }
 };
 
 class FrameTable {
+    private:
+    // one free list per NUMA node
+    vector<list<FrameEntry*>> freeFrames;
+    // with huge pages (-H) one buddy allocator per node instead
+    vector<BuddyAllocator> buddies;
+    int freeCount = 0;
+
     public:
     vector<FrameEntry*> frames;
-    list<FrameEntry*> freeFrames;
     Pager* pager;
+    // while restricted, only frames whose first mapping belongs to a process with victimOwners set may be victims
+    bool restricted = false;
+    vector<char> victimOwners;
 
-    FrameTable(int frameTableSize, Pager* pg): pager(pg) {
+    FrameTable(int frameTableSize, Pager* pg): freeFrames(NUMA_NODES), pager(pg) {
         for (int i = 0; i < frameTableSize; i++) {
             FrameEntry* fe = new FrameEntry(i);
+            fe->node = (long long) i * NUMA_NODES / frameTableSize;
             frames.push_back(fe);
-            freeFrames.push_back(fe);
+            if (HUGE_PAGE_SIZE == 0) {
+                freeFrames[fe->node].push_back(fe);
+            }
+        }
+        for (int node = 0, first = 0; HUGE_PAGE_SIZE > 0 && node < NUMA_NODES; node++) {
+            int last = first;
+            while (last < frameTableSize && frames[last]->node == node) {
+                last++;
+            }
+            buddies.push_back(BuddyAllocator(first, last, HUGE_ORDER));
+            first = last;
         }
+        freeCount = frameTableSize;
     }
 
-    void makeFrameAvailable(FrameEntry* frame) {
-        freeFrames.push_back(frame);
+    int getFreeCount() { return freeCount; }
+
+    bool isCandidate(FrameEntry* fe) { return fe->isMapped && (!restricted || victimOwners[fe->processId]); }
+
+    bool hasFreeFrame() { return freeCount > 0; }
+
+    // free blocks of 2^order frames over all nodes
+    int getFreeBlocks(int order) {
+        int blocks = 0;
+        for (auto it = buddies.begin(); it != buddies.end(); ++it) {
+            blocks = blocks + it->getFreeBlocks(order);
+        }
+        return blocks;
     }
 
-    FrameEntry* getNextFrame() {
-        FrameEntry* fe;
-        if (!freeFrames.empty()) {
-            fe = freeFrames.front();
-            freeFrames.pop_front();
+    void makeFrameAvailable(FrameEntry* frame) {
+        if (buddies.empty()) {
+            freeFrames[frame->node].push_back(frame);
         } else {
+            buddies[frame->node].free(frame->frameId, 0);
+        }
+        freeCount++;
+    }
+
+    // a free frame on node, else with fallback on the next node that has one, nullptr when there is none
+    FrameEntry* takeFreeFrame(int node, bool fallback = true) {
+        for (int i = 0; i < (fallback ? NUMA_NODES : 1); i++) {
+            int candidate = (node + i) % NUMA_NODES;
+            if (!buddies.empty()) {
+                int frame = buddies[candidate].allocate(0);
+                if (frame >= 0) {
+                    freeCount--;
+                    return frames[frame];
+                }
+            } else if (!freeFrames[candidate].empty()) {
+                FrameEntry* fe = freeFrames[candidate].front();
+                freeFrames[candidate].pop_front();
+                freeCount--;
+                return fe;
+            }
+        }
+        return nullptr;
+    }
+
+    // the first of 2^order contiguous free frames, node-local first, nullptr when no node has such a block
+    FrameEntry* takeFreeBlock(int node, int order) {
+        for (int i = 0; i < NUMA_NODES && !buddies.empty(); i++) {
+            int frame = buddies[(node + i) % NUMA_NODES].allocate(order);
+            if (frame >= 0) {
+                freeCount = freeCount - (1 << order);
+                return frames[frame];
+            }
+        }
+        return nullptr;
+    }
+
+    // node-local first, the pager picks a victim anywhere once no node has a free frame
+    FrameEntry* getNextFrame(int node) {
+        FrameEntry* fe = takeFreeFrame(node);
+        if (fe == nullptr) {
             fe = pager->getVictimFrame();
         }
         pager->frameSelected(fe);
@@ -122,29 +554,409 @@ class FrameTable {
     }
 };
 
-class Instruction {
+class MappedFile {
+    public:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+
+    MappedFile(const string& fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            opened = true;
+            size = st.st_size;
+            if (size > 0) {
+                void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr == MAP_FAILED) {
+                    opened = false;
+                    size = 0;
+                } else {
+                    madvise(addr, size, MADV_SEQUENTIAL);
+                    data = (const char*) addr;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (data != nullptr) {
+            munmap((void*) data, size);
+        }
+    }
+};
+
+// from_chars-style parse of the next number on the current line, returns false at end of line or input
+bool parseLong(const char* data, size_t size, size_t& pos, long& value) {
+    while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r')) {
+        pos++;
+    }
+    if (pos >= size || data[pos] == '\n') {
+        return false;
+    }
+    bool negative = data[pos] == '-';
+    if (negative || data[pos] == '+') {
+        pos++;
+    }
+    long v = 0;
+    while (pos < size && (unsigned) (data[pos] - '0') < 10) {
+        v = v * 10 + (data[pos] - '0');
+        pos++;
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+// moves pos to the start of the next line that is neither empty nor a # comment
+bool skipToTextLine(const char* data, size_t size, size_t& pos) {
+    while (pos < size && (data[pos] == '\n' || data[pos] == '#')) {
+        if (data[pos] == '#') {
+            const char* nl = (const char*) memchr(data + pos, '\n', size - pos);
+            pos = nl == nullptr ? size : nl - data;
+        }
+        pos++;
+    }
+    return pos < size;
+}
+
+void skipTextLine(const char* data, size_t size, size_t& pos) {
+    const char* nl = (const char*) memchr(data + pos, '\n', size - pos);
+    pos = nl == nullptr ? size : nl - data + 1;
+}
+
+// Packed binary trace written by -c<file>: the header, then per process its VMA count and VMAs, then
+// one record per instruction (value << 2 | type code), 4 bytes wide when every value fits, else 8.
+const char TRACE_MAGIC[8] = {'M', 'M', 'U', 'T', 'R', 'C', '3', '\0'};
+const char TRACE_TYPES[4] = {'r', 'w', 'c', 'e'};
+
+int64_t packRecord(char type, long value) {
+    int64_t code = type == 'r' ? 0 : type == 'w' ? 1 : type == 'c' ? 2 : 3;
+    return (int64_t) value * 4 + code;
+}
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t recordSize, numProcesses;
+    uint64_t numRecords;
+};
+
+struct TraceVMA {
+    int64_t start, end;
+    int32_t writeProtected, fileMapped, object, privateMapping, hugePage;
+};
+
+// Reads the instructions straight out of the mapped input, text or packed binary, so a run needs no
+// per-instruction memory and can be rewound for the next run of a miss-ratio curve. Copies share the
+// input and keep their own position, one per parallel run (-j).
+class InstructionStream {
+    private:
+    // the mapped file, or the records decode() built from a text trace
+    shared_ptr<const void> storage;
+    const char* data = nullptr;
+    size_t length = 0;
+    bool opened = false;
+    size_t start = 0, pos = 0;
+    // 0 for a text trace
+    uint32_t recordSize = 0;
+    unsigned long records = ULONG_MAX;
+
     public:
-    char instrType;
-    int value;
+    InstructionStream(const string& fileName) {
+        shared_ptr<MappedFile> file = make_shared<MappedFile>(fileName);
+        data = file->data;
+        length = file->size;
+        opened = file->opened;
+        storage = file;
+    }
+
+    bool isOpen() { return opened; }
+
+    bool isBinary() {
+        return length >= sizeof(TraceHeader) && memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0;
+    }
+
+    // parses the process section and leaves the stream at the first instruction
+    void readProcesses(vector<Process*>& processes) {
+        if (isBinary()) {
+            TraceHeader header;
+            memcpy(&header, data, sizeof(header));
+            recordSize = header.recordSize;
+            records = header.numRecords;
+            pos = sizeof(header);
+            for (uint32_t id = 0; id < header.numProcesses; id++) {
+                Process* proc = new Process(id, new ProcessStats());
+                uint32_t numVma;
+                memcpy(&numVma, data + pos, sizeof(numVma));
+                pos = pos + sizeof(numVma);
+                for (uint32_t vma = 0; vma < numVma; vma++, pos += sizeof(TraceVMA)) {
+                    TraceVMA v;
+                    memcpy(&v, data + pos, sizeof(v));
+                    proc->addVma(new VMA(v.start, v.end, v.writeProtected, v.fileMapped, v.object, v.privateMapping, v.hugePage));
+                    SHARED_OBJECTS = SHARED_OBJECTS || (v.object >= 0 && v.fileMapped == 1);
+                }
+                processes.push_back(proc);
+            }
+            pos = (pos + 7) & ~(size_t) 7;
+        } else {
+            long numProcesses = 0;
+            skipToTextLine(data, length, pos);
+            parseLong(data, length, pos, numProcesses);
+            skipTextLine(data, length, pos);
+            for (int id = 0; id < numProcesses; id++) {
+                Process* proc = new Process(id, new ProcessStats());
+                long numVma = 0;
+                skipToTextLine(data, length, pos);
+                parseLong(data, length, pos, numVma);
+                skipTextLine(data, length, pos);
+                for (int vma = 0; vma < numVma; vma++) {
+                    // an optional fifth and sixth field name a shared object and make the mapping private, a seventh
+                    // makes the VMA eligible for huge pages
+                    long start = 0, end = 0, wp = 0, fm = 0, object = -1, priv = 0, huge = 0;
+                    skipToTextLine(data, length, pos);
+                    parseLong(data, length, pos, start);
+                    parseLong(data, length, pos, end);
+                    parseLong(data, length, pos, wp);
+                    parseLong(data, length, pos, fm);
+                    if (parseLong(data, length, pos, object) && parseLong(data, length, pos, priv)) {
+                        parseLong(data, length, pos, huge);
+                    }
+                    skipTextLine(data, length, pos);
+                    if (fm == 0) {
+                        // sharing is only modelled for file-backed objects
+                        object = -1, priv = 0;
+                    }
+                    proc->addVma(new VMA(start, end, wp, fm, object, priv, huge));
+                    SHARED_OBJECTS = SHARED_OBJECTS || object >= 0;
+                }
+                processes.push_back(proc);
+            }
+        }
+        start = pos;
+    }
+
+    bool next(char& type, long& value) {
+        if (recordSize == 0) {
+            if (!skipToTextLine(data, length, pos)) {
+                return false;
+            }
+            type = data[pos++];
+            value = 0;
+            parseLong(data, length, pos, value);
+            skipTextLine(data, length, pos);
+            return true;
+        }
+        if (pos + recordSize > length) {
+            return false;
+        }
+        if (recordSize == 4) {
+            uint32_t record;
+            memcpy(&record, data + pos, sizeof(record));
+            type = TRACE_TYPES[record & 3];
+            value = record >> 2;
+        } else {
+            int64_t record;
+            memcpy(&record, data + pos, sizeof(record));
+            type = TRACE_TYPES[record & 3];
+            value = record >> 2;
+        }
+        pos = pos + recordSize;
+        return true;
+    }
+
+    void rewind() {
+        pos = start;
+    }
+
+    // instruction count, a text trace is counted with one extra pass the first time
+    unsigned long size() {
+        if (records == ULONG_MAX) {
+            char type;
+            long value;
+            records = 0;
+            rewind();
+            while (next(type, value)) {
+                records++;
+            }
+            rewind();
+        }
+        return records;
+    }
 
-    Instruction(char inTp, int v): instrType(inTp), value(v) {}
+    // parses a text trace once into 8-byte records in memory, which copies of the stream then share
+    void decode() {
+        if (recordSize != 0) {
+            return;
+        }
+        shared_ptr<vector<int64_t>> decoded = make_shared<vector<int64_t>>();
+        char type;
+        long value;
+        for (rewind(); next(type, value); ) {
+            decoded->push_back(packRecord(type, value));
+        }
+        data = (const char*) decoded->data();
+        length = decoded->size() * sizeof(int64_t);
+        storage = decoded;
+        recordSize = sizeof(int64_t);
+        records = decoded->size();
+        start = 0, pos = 0;
+    }
 };
 
-string INPUT_FILE, RAND_FILE;
-char PAGING_ALGO_PARAM;
-FrameTable* frameTable = nullptr;
-Process* CURRENT_PROCESS = nullptr;
-vector<Instruction*> instructions;
-vector<Process*> processList;
+string INPUT_FILE, RAND_FILE, CONVERT_FILE, PROFILE_FILE;
+// the state of one run is thread_local, parallel runs (-j) only share the trace, the VMAs and the config below
+thread_local char PAGING_ALGO_PARAM;
+thread_local FrameTable* frameTable = nullptr;
+thread_local Process* CURRENT_PROCESS = nullptr;
+thread_local InstructionStream* trace = nullptr;
+thread_local vector<Process*> processList;
 vector<int> randvals;
-unsigned long instCount = 0, ctxSwitches = 0, processExits = 0;
-unsigned long long totalCost = 0;
+thread_local unsigned long instCount = 0, ctxSwitches = 0, processExits = 0;
+thread_local unsigned long long totalCost = 0;
 bool PRINT_PTE_EACH_INSTR = false, PRINT_ALL_PTE = false, PRINT_FTE_EACH_INSTR = false, PRINT_ASELECT = false;
-bool PRINT_FINAL_PAGE_TABLES = false, PRINT_FINAL_FRAME_TABLE = false, PRINT_FINAL_STATS = false, PRINT_STEPS = false;
-int RAND_OFFSET = 0, RAND_LIMIT = 0;
+bool PRINT_FINAL_PAGE_TABLES = false, PRINT_FINAL_FRAME_TABLE = false, PRINT_FINAL_STATS = false, PRINT_STEPS = false, PRINT_EXITS = true;
+int MRC_MAX_FRAMES = 0;
+// -1 when the page cleaner is off
+int CLEANER_PERIOD = -1, CLEANER_LOW = -1, CLEANER_HIGH = -1, CLEANER_BATCH = -1;
+// pages mapped after a faulting one, 0 when readahead is off, the maximum when adaptive
+int READAHEAD_WINDOW = 0;
+bool READAHEAD_ADAPTIVE = false;
+// frames given to the compressed swap pool and compressed pages per frame, 0 when the pool is off
+int ZSWAP_FRAMES = 0, ZSWAP_RATIO = 3;
+// remote references after which a page is migrated to its process's node, 0 never migrates
+int NUMA_MIGRATE = 0;
+// references of a process between quota adjustments, 0 for global replacement, and the fault rates in percent
+// below which its quota shrinks and above which it grows
+int PFF_WINDOW = 0, PFF_LOW = 2, PFF_HIGH = 10;
+// TLB entries, 0 when no TLB is simulated
+int TLB_SIZE = 0, TLB_WAYS = 4;
+bool TLB_ASID = false, TLB_LRU = true;
+// worker threads for the runs of every pager in PAGING_ALGOS with every frame count in FRAME_COUNTS, 0 runs one simulation
+int PARALLEL_RUNS = 0;
+string PAGING_ALGOS;
+vector<int> FRAME_COUNTS;
+thread_local int RAND_OFFSET = 0;
+int RAND_LIMIT = 0;
+
+// Set-associative TLB in front of the page tables. Entries are tagged with the pid when ASIDs are on,
+// otherwise the whole TLB is flushed on every context switch. Unmapping a page shoots down its entry,
+// so a hit always refers to a present page. A huge page (-H) takes one entry for all of its pages.
+class TLB {
+    private:
+    struct Entry {
+        bool valid = false;
+        int asid = 0;
+        long vpage = 0;
+        unsigned long long stamp = 0;
+    };
+    vector<Entry> entries;
+    int sets, ways;
+    bool useAsid, useLRU;
+    unsigned long long clock = 0;
+
+    Entry* findEntry(int asid, long vpage) {
+        Entry* set = &entries[(vpage % sets) * ways];
+        for (int i = 0; i < ways; i++) {
+            if (set[i].valid && set[i].vpage == vpage && set[i].asid == asid) {
+                return &set[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // huge page entries are tagged with the block number above the address space
+    static long hugeTag(long vpage) {
+        return PageTable::MAX_VPAGES + vpage / HUGE_PAGE_SIZE;
+    }
+
+    public:
+    unsigned long flushes = 0, shootdowns = 0;
+
+    TLB(int size, int w, bool asid, bool lru): ways(w), useAsid(asid), useLRU(lru) {
+        ways = max(1, min(ways, size));
+        sets = max(1, size / ways);
+        entries.resize(sets * ways);
+    }
+
+    // true on a hit, a miss is charged here and filled by insert() once the translation succeeded
+    bool lookup(Process* proc, long vpage) {
+        Entry* entry = findEntry(useAsid ? proc->id : 0, vpage);
+        if (entry == nullptr && HUGE_PAGE_SIZE > 0) {
+            entry = findEntry(useAsid ? proc->id : 0, hugeTag(vpage));
+        }
+        if (entry != nullptr) {
+            if (useLRU) { entry->stamp = ++clock; }
+            proc->pstats->tlbHits = proc->pstats->tlbHits + 1;
+            return true;
+        }
+        proc->pstats->tlbMisses = proc->pstats->tlbMisses + 1;
+        totalCost = totalCost + instrCostMap[TLBMISS] + instrCostMap[PAGEWALK];
+        return false;
+    }
+
+    void insert(Process* proc, long vpage, bool huge = false) {
+        int asid = useAsid ? proc->id : 0;
+        vpage = huge ? hugeTag(vpage) : vpage;
+        Entry* set = &entries[(vpage % sets) * ways];
+        Entry* victim = &set[0];
+        for (int i = 0; i < ways; i++) {
+            if (!set[i].valid) {
+                victim = &set[i];
+                break;
+            }
+            if (set[i].stamp < victim->stamp) {
+                victim = &set[i];
+            }
+        }
+        victim->valid = true;
+        victim->asid = asid;
+        victim->vpage = vpage;
+        victim->stamp = ++clock;
+    }
+
+    void invalidate(int pid, long vpage, bool huge = false) {
+        // without ASIDs only the running process has entries, the others' were flushed when it was switched in
+        if (!useAsid && (CURRENT_PROCESS == nullptr || pid != CURRENT_PROCESS->id)) {
+            return;
+        }
+        Entry* entry = findEntry(useAsid ? pid : 0, huge ? hugeTag(vpage) : vpage);
+        if (entry != nullptr) {
+            entry->valid = false;
+            shootdowns++;
+        }
+    }
+
+    void contextSwitch() {
+        if (!useAsid) {
+            flush();
+            flushes++;
+        }
+    }
 
+    void flush() {
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            it->valid = false;
+        }
+    }
+
+    void reset() {
+        flush();
+        clock = 0, flushes = 0, shootdowns = 0;
+    }
+
+    void printStats() {
+        printf("TLB: %d sets %d ways %s %s flushes=%lu shootdowns=%lu\n", sets, ways, useAsid ? "asid" : "flush",
+            useLRU ? "lru" : "fifo", flushes, shootdowns);
+    }
+};
+
+thread_local TLB* tlb = nullptr;
 
-class FIFO: public Pager {
+
+class FIFO final: public Pager {
     public:
     int index = 0;
 
@@ -153,8 +965,11 @@ class FIFO: public Pager {
     }
 
     FrameEntry* getVictimFrame() {
+        while (!frameTable->isCandidate(frameTable->frames[index])) {
+            index = (index + 1) % FRAME_TABLE_SIZE;
+        }
         if (PRINT_ASELECT) {
-            cout << "ASELECT " << index << "\n";
+            writer << "ASELECT " << index << "\n";
         }
         FrameEntry* fe = frameTable->frames[index];
         index = (index + 1) % FRAME_TABLE_SIZE;
@@ -168,20 +983,23 @@ int getRandomNumber(int MOD) {
     return val;
 }
 
-class RANDOM: public Pager {
+class RANDOM final: public Pager {
     public:
     void frameSelected(FrameEntry* fte) {
         // do nothing
     }
 
+    // one random number per fault, from there the first frame that may be a victim
     FrameEntry* getVictimFrame() {
         int index = getRandomNumber(FRAME_TABLE_SIZE);
-        FrameEntry* fe = frameTable->frames[index];
-        return fe;
+        while (!frameTable->isCandidate(frameTable->frames[index])) {
+            index = (index + 1) % FRAME_TABLE_SIZE;
+        }
+        return frameTable->frames[index];
     }
 };
 
-class CLOCK: public Pager {
+class CLOCK final: public Pager {
     public:
     int index = 0;
 
@@ -193,15 +1011,15 @@ class CLOCK: public Pager {
         int startIndex = index, count = 0;
         while (true) {
             FrameEntry* fe = frameTable->frames[index];
-            int pId = fe->processId, vpage = fe->pageValue;
             count++;
-            if (processList[pId]->pte[vpage].referenced == 1) {
-                PTE* pte = &processList[pId]->pte[vpage];
-                pte->referenced = 0;
+            if (!frameTable->isCandidate(fe)) {
+                index = (index + 1) % FRAME_TABLE_SIZE;
+            } else if (isFrameReferenced(fe)) {
+                clearFrameReferenced(fe);
                 index = (index + 1) % FRAME_TABLE_SIZE;
             } else {
                 if (PRINT_ASELECT) {
-                    cout << "ASELECT " << startIndex << " " << count << "\n";
+                    writer << "ASELECT " << startIndex << " " << count << "\n";
                 }
                 index = (index + 1) % FRAME_TABLE_SIZE;
                 return fe;
@@ -210,7 +1028,7 @@ class CLOCK: public Pager {
     }
 };
 
-class NRU: public Pager {
+class NRU final: public Pager {
     private:
     int index = 0;
     int lastInstrReset = -1;
@@ -228,8 +1046,12 @@ class NRU: public Pager {
         
         while (count < FRAME_TABLE_SIZE) {
             FrameEntry* frame = frameTable->frames[index];
-            int pId = frame->processId, vpage = frame->pageValue;
-            int score = 2 * processList[pId]->pte[vpage].referenced + processList[pId]->pte[vpage].modified;
+            if (!frameTable->isCandidate(frame)) {
+                index = (index + 1) % FRAME_TABLE_SIZE;
+                count++;
+                continue;
+            }
+            int score = 2 * isFrameReferenced(frame) + isFrameModified(frame);
             if (victim[score] == -1) {
                 victim[score] = index;
             }
@@ -237,8 +1059,7 @@ class NRU: public Pager {
                 lowestClass = score;
             }
             if (resetRef) {
-                PTE* pte = &processList[pId]->pte[vpage];
-                pte->referenced = 0;
+                clearFrameReferenced(frame);
             }
             index = (index + 1) % FRAME_TABLE_SIZE;
             count++;
@@ -249,56 +1070,114 @@ class NRU: public Pager {
         
         index = (victim[lowestClass] + 1) % FRAME_TABLE_SIZE;
         if (PRINT_ASELECT) {
-            cout << "ASELECT: hand="; printElement(startIndex, 2); cout << " " << resetRef << " | " << lowestClass << " ";
-            printElement(victim[lowestClass], 2); cout << " "; printElement(count, 2); cout << "\n";
+            writer << "ASELECT: hand="; printElement(startIndex, 2); writer << " " << resetRef << " | " << lowestClass << " ";
+            printElement(victim[lowestClass], 2); writer << " "; printElement(count, 2); writer << "\n";
         }
         return frameTable->frames[victim[lowestClass]];
     }
 };
 
-class AGING: public Pager {
+// ages[i] = ages[i] >> 1 | refs[i] with refs cleared, refs hold the R bit already shifted to bit 31.
+// Returns the smallest new age.
+unsigned int ageFrames(unsigned int* ages, unsigned int* refs, int n) {
+    int i = 0;
+    unsigned int lowest = UINT_MAX;
+#ifdef __SSE2__
+    // SSE2 has no unsigned 32-bit min, so compare with the sign bit flipped
+    const __m128i bias = _mm_set1_epi32(0x80000000), zero = _mm_setzero_si128();
+    __m128i low = _mm_set1_epi32(0x7fffffff);
+    for (; i + 4 <= n; i += 4) {
+        __m128i age = _mm_loadu_si128((__m128i*) (ages + i));
+        age = _mm_or_si128(_mm_srli_epi32(age, 1), _mm_loadu_si128((__m128i*) (refs + i)));
+        _mm_storeu_si128((__m128i*) (ages + i), age);
+        _mm_storeu_si128((__m128i*) (refs + i), zero);
+        __m128i biased = _mm_xor_si128(age, bias);
+        __m128i less = _mm_cmplt_epi32(biased, low);
+        low = _mm_or_si128(_mm_and_si128(less, biased), _mm_andnot_si128(less, low));
+    }
+    unsigned int lanes[4];
+    _mm_storeu_si128((__m128i*) lanes, _mm_xor_si128(low, bias));
+    lowest = min(min(lanes[0], lanes[1]), min(lanes[2], lanes[3]));
+#endif
+    for (; i < n; i++) {
+        ages[i] = (ages[i] >> 1) | refs[i];
+        refs[i] = 0;
+        lowest = min(lowest, ages[i]);
+    }
+    return lowest;
+}
+
+// Ages and R bits live in per-frame arrays so the scan on a fault is one ageFrames() pass instead of a
+// walk through every FrameEntry and PTE. The R bit is copied here on every reference, frames whose bit
+// was set since the last scan are remembered so only their PTE bits have to be cleared.
+class AGING final: public Pager {
     public:
     int index = 0;
+    vector<unsigned int> ages, refs;
+    vector<int> touched;
+
+    AGING(): ages(FRAME_TABLE_SIZE, 0), refs(FRAME_TABLE_SIZE, 0) {}
 
     void frameSelected(FrameEntry* fte) {
-        fte->age = 0;
+        ages[fte->frameId] = 0;
+        refs[fte->frameId] = 0;
+    }
+
+    void frameReferenced(FrameEntry* fte) {
+        if (refs[fte->frameId] == 0) {
+            refs[fte->frameId] = 0x80000000;
+            touched.push_back(fte->frameId);
+        }
     }
 
     FrameEntry* getVictimFrame() {
-        int count = 0, lowestIndex = index, lowestAge = 0x80000001, startIndex = index;
-        string frameOut = "";
-        
-        while (count < FRAME_TABLE_SIZE) {
-            FrameEntry* fe = frameTable->frames[index];
-            int pId = fe->processId, vpage = fe->pageValue;
-            PTE* pte = &processList[pId]->pte[vpage];
-            fe->age = fe->age >> 1;
-            if (pte->referenced == 1) {
-                fe->age = (fe->age | 0x80000000);
+        int startIndex = index;
+        for (auto it = touched.begin(); it != touched.end(); ++it) {
+            if (frameTable->frames[*it]->isMapped) {
+                clearFrameReferenced(frameTable->frames[*it]);
             }
-            pte->referenced = 0;
-            if (fe->age < lowestAge) {
-                lowestAge = fe->age;
-                lowestIndex = index;
+        }
+        touched.clear();
+        unsigned int lowestAge = ageFrames(ages.data(), refs.data(), FRAME_TABLE_SIZE);
+
+        // the first frame at or after the hand with the lowest age, ages of 0x80000001 and up never
+        // count as lower than the initial bound, in which case the hand itself is taken
+        int lowestIndex = startIndex;
+        if (frameTable->hasFreeFrame() || frameTable->restricted) {
+            // free frames take part in the vector pass but cannot be victims, redo the reduction over the candidates
+            lowestAge = 0x80000001;
+            for (int count = 0, i = startIndex; count < FRAME_TABLE_SIZE; count++, i = (i + 1) % FRAME_TABLE_SIZE) {
+                if (frameTable->isCandidate(frameTable->frames[i]) && ages[i] < lowestAge) {
+                    lowestAge = ages[i];
+                    lowestIndex = i;
+                }
             }
-            if (PRINT_ASELECT) {
-                std::stringstream ss;
-                ss << std::hex << fe->age;
-                frameOut = frameOut + " " + std::to_string(index) + ":" + ss.str();
+            while (!frameTable->isCandidate(frameTable->frames[lowestIndex])) {
+                lowestIndex = (lowestIndex + 1) % FRAME_TABLE_SIZE;
             }
-            index = (index + 1) % FRAME_TABLE_SIZE;
-            count++;
+        } else if (lowestAge < 0x80000001) {
+            int i = startIndex;
+            while (ages[i] != lowestAge) {
+                i = (i + 1) % FRAME_TABLE_SIZE;
+            }
+            lowestIndex = i;
         }
 
         if (PRINT_ASELECT) {
-            cout << "ASELECT " << startIndex << "-" << ((index - 1 + FRAME_TABLE_SIZE) % FRAME_TABLE_SIZE) << " |" << frameOut << " | " << lowestIndex << "\n";
+            string frameOut = "";
+            for (int count = 0, i = startIndex; count < FRAME_TABLE_SIZE; count++, i = (i + 1) % FRAME_TABLE_SIZE) {
+                std::stringstream ss;
+                ss << std::hex << ages[i];
+                frameOut = frameOut + " " + std::to_string(i) + ":" + ss.str();
+            }
+            writer << "ASELECT " << startIndex << "-" << ((startIndex - 1 + FRAME_TABLE_SIZE) % FRAME_TABLE_SIZE) << " |" << frameOut << " | " << lowestIndex << "\n";
         }
         index = (lowestIndex + 1) % FRAME_TABLE_SIZE;
         return frameTable->frames[lowestIndex];
     }
 };
 
-class WSET: public Pager {
+class WSET final: public Pager {
     private:
     int index = 0;
     const int TIME_THRESHOLD = 50;
@@ -315,15 +1194,21 @@ class WSET: public Pager {
         while (count < FRAME_TABLE_SIZE) {
             count++;
             FrameEntry* fe = frameTable->frames[index];
-            int pId = fe->processId, vpage = fe->pageValue;
-            PTE* pte = &processList[pId]->pte[vpage];
+            if (!frameTable->isCandidate(fe)) {
+                if (lowestIndex == index) { lowestIndex = (index + 1) % FRAME_TABLE_SIZE; }
+                index = (index + 1) % FRAME_TABLE_SIZE;
+                continue;
+            }
+            int pId = fe->processId;
+            long vpage = fe->pageValue;
+            bool referenced = isFrameReferenced(fe);
             if (PRINT_ASELECT) {
-                frameOut = frameOut + " " + to_string(index) + "(" + to_string(pte->referenced) + " " + to_string(pId) + ":" + to_string(vpage) + " " + 
+                frameOut = frameOut + " " + to_string(index) + "(" + to_string(referenced ? 1 : 0) + " " + to_string(pId) + ":" + to_string(vpage) + " " + 
                             to_string(fe->timeLastUse) + ")";
             }
-            if (pte->referenced == 1) {
+            if (referenced) {
                 fe->timeLastUse = instCount;
-                pte->referenced = 0;
+                clearFrameReferenced(fe);
             } else if ((instCount - fe->timeLastUse) >= TIME_THRESHOLD) {
                 lowestIndex = index;
                 if (PRINT_ASELECT) { frameOut = frameOut + " STOP(" + to_string(count) + ")"; }
@@ -336,7 +1221,7 @@ class WSET: public Pager {
         }
 
         if (PRINT_ASELECT) {
-            cout << "ASELECT " << startIndex << "-" << ((startIndex - 1 + FRAME_TABLE_SIZE) % FRAME_TABLE_SIZE) << " |" << frameOut << " | " << lowestIndex << "\n";
+            writer << "ASELECT " << startIndex << "-" << ((startIndex - 1 + FRAME_TABLE_SIZE) % FRAME_TABLE_SIZE) << " |" << frameOut << " | " << lowestIndex << "\n";
         }
         index = (lowestIndex + 1) % FRAME_TABLE_SIZE;
         return frameTable->frames[lowestIndex];
@@ -344,49 +1229,247 @@ class WSET: public Pager {
 };
 
 
-string readLineFromFile(ifstream* fileStream) {
-    string line;
-    while (getline(*fileStream, line)) {
-        if (line.empty() || line[0] == '#') {
-            continue;
+class LRU final: public Pager {
+    private:
+    // recency list threaded through the frames themselves, head is most recently used
+    FrameEntry* head = nullptr;
+    FrameEntry* tail = nullptr;
+
+    void unlink(FrameEntry* fte) {
+        if (fte->lruPrev != nullptr) {
+            fte->lruPrev->lruNext = fte->lruNext;
+        } else if (head == fte) {
+            head = fte->lruNext;
+        }
+        if (fte->lruNext != nullptr) {
+            fte->lruNext->lruPrev = fte->lruPrev;
+        } else if (tail == fte) {
+            tail = fte->lruPrev;
+        }
+        fte->lruPrev = nullptr;
+        fte->lruNext = nullptr;
+    }
+
+    public:
+    void frameSelected(FrameEntry* fte) {
+        // do nothing
+    }
+
+    void frameReferenced(FrameEntry* fte) {
+        if (head == fte) {
+            return;
+        }
+        unlink(fte);
+        fte->lruNext = head;
+        if (head != nullptr) {
+            head->lruPrev = fte;
+        }
+        head = fte;
+        if (tail == nullptr) {
+            tail = fte;
+        }
+    }
+
+    // unreferenced prefetched pages are the least recently used
+    void framePrefetched(FrameEntry* fte) {
+        unlink(fte);
+        fte->lruPrev = tail;
+        if (tail != nullptr) {
+            tail->lruNext = fte;
+        }
+        tail = fte;
+        if (head == nullptr) {
+            head = fte;
+        }
+    }
+
+    // every mapped frame has been referenced or prefetched since it was loaded
+    FrameEntry* getVictimFrame() {
+        FrameEntry* fe = tail;
+        while (!fe->isMapped) {
+            unlink(fe);
+            fe = tail;
+        }
+        while (!frameTable->isCandidate(fe)) {
+            fe = fe->lruPrev;
+        }
+        if (PRINT_ASELECT) {
+            writer << "ASELECT " << fe->frameId << "\n";
         }
-        return line;
+        unlink(fe);
+        return fe;
     }
-    return "";
+};
+
+// nextUse[i] is the index of the next reference to the page referenced by instruction i, or LLONG_MAX when
+// the page is not used again before its process exits. Built backwards once over the loaded trace; 64-bit
+// since binary traces (-c) can hold more than 2^31 instructions.
+vector<long long> nextUse;
+
+long long getPageKey(int pid, long vpage) {
+    return ((long long) pid << PageTable::VPAGE_BITS) | vpage;
 }
 
-void readInputFile(string fileName) {
-    ifstream inputFile(fileName);
-    if (inputFile.is_open()) {
-        int numProcesses = stoi(readLineFromFile(&inputFile));
-        for (int id = 0; id < numProcesses; id++) {
-            ProcessStats* pstats = new ProcessStats();
-            Process* proc = new Process(id, pstats);
-            int numVma = stoi(readLineFromFile(&inputFile));
-            for (int vma = 0; vma < numVma; vma++) {
-                std::istringstream iss(readLineFromFile(&inputFile));
-                int start, end, wp, fm;
-                iss >> start >> end >> wp >> fm;
-                VMA* vmaObj = new VMA(start, end, wp, fm);
-                proc->addVma(vmaObj);
-            }
-            processList.push_back(proc);
-        }
-        string line = readLineFromFile(&inputFile);
-        while (line != "") {
-            std::istringstream iss(line);
-            char inst; int val;
-            iss >> inst >> val;
-            Instruction* ins = new Instruction(inst, val);
-            instructions.push_back(ins);
-            line = readLineFromFile(&inputFile);
+long long VMA::getObjectKey(long vpage) {
+    return ((long long) object << PageTable::VPAGE_BITS) | (vpage - startVPage);
+}
+
+void buildNextUseIndex() {
+    // OPT needs the whole future, so unlike a normal run this keeps one key per instruction:
+    // the page key of a reference, -1 for a context switch and -(pid + 2) for an exit
+    vector<long long> keys;
+    keys.reserve(trace->size());
+    char instType;
+    long value;
+    int pid = -1;
+    for (trace->rewind(); trace->next(instType, value); ) {
+        if (instType == 'c') {
+            pid = value;
+            keys.push_back(-1);
+        } else if (instType == 'e') {
+            keys.push_back(-(long long) pid - 2);
+        } else if (instType == 'r' || instType == 'w') {
+            keys.push_back(getPageKey(pid, value));
+        } else {
+            keys.push_back(-1);
         }
-        inputFile.close();
+    }
+    map<long long, long long> upcoming;
+    nextUse.assign(keys.size(), LLONG_MAX);
+    for (long long i = (long long) keys.size() - 1; i >= 0; i--) {
+        if (keys[i] < -1) {
+            int exited = -keys[i] - 2;
+            upcoming.erase(upcoming.lower_bound(getPageKey(exited, 0)), upcoming.lower_bound(getPageKey(exited + 1, 0)));
+        } else if (keys[i] >= 0) {
+            auto it = upcoming.find(keys[i]);
+            nextUse[i] = it == upcoming.end() ? LLONG_MAX : it->second;
+            upcoming[keys[i]] = i;
+        }
+    }
+}
+
+class OPT final: public Pager {
+    private:
+    vector<long long> frameNextUse;
+    // max-heap of (next use, frame), entries go stale when the frame is referenced again and are skipped
+    priority_queue<pair<long long, int>> heap;
+
+    public:
+    OPT() {
+        if (nextUse.size() != trace->size()) {
+            buildNextUseIndex();
+        }
+    }
+
+    void frameSelected(FrameEntry* fte) {
+        // do nothing
+    }
+
+    void frameReferenced(FrameEntry* fte) {
+        if ((int) frameNextUse.size() < FRAME_TABLE_SIZE) {
+            frameNextUse.resize(FRAME_TABLE_SIZE, LLONG_MAX);
+        }
+        frameNextUse[fte->frameId] = nextUse[instCount];
+        heap.push(make_pair(nextUse[instCount], fte->frameId));
+        if ((int) heap.size() > 4 * FRAME_TABLE_SIZE) {
+            heap = priority_queue<pair<long long, int>>();
+            for (int i = 0; i < FRAME_TABLE_SIZE; i++) {
+                if (frameTable->frames[i]->isMapped) {
+                    heap.push(make_pair(frameNextUse[i], i));
+                }
+            }
+        }
+    }
+
+    // the next use is only indexed by instruction, so a prefetched page counts as never used again
+    void framePrefetched(FrameEntry* fte) {
+        if ((int) frameNextUse.size() < FRAME_TABLE_SIZE) {
+            frameNextUse.resize(FRAME_TABLE_SIZE, LLONG_MAX);
+        }
+        frameNextUse[fte->frameId] = LLONG_MAX;
+        heap.push(make_pair(LLONG_MAX, fte->frameId));
+    }
+
+    FrameEntry* getVictimFrame() {
+        // current entries of frames that are not candidates go back on the heap
+        vector<pair<long long, int>> skipped;
+        while (true) {
+            pair<long long, int> top = heap.top();
+            heap.pop();
+            FrameEntry* fe = frameTable->frames[top.second];
+            if (fe->isMapped && frameNextUse[top.second] == top.first) {
+                if (!frameTable->isCandidate(fe)) {
+                    skipped.push_back(top);
+                    continue;
+                }
+                for (auto it = skipped.begin(); it != skipped.end(); ++it) {
+                    heap.push(*it);
+                }
+                if (PRINT_ASELECT) {
+                    writer << "ASELECT " << top.second << " " << (top.first == LLONG_MAX ? -1 : top.first) << "\n";
+                }
+                return fe;
+            }
+        }
+    }
+};
+
+void readInputFile(string fileName) {
+    trace = new InstructionStream(fileName);
+    if (trace->isOpen()) {
+        trace->readProcesses(processList);
     } else {
         cout << "Unable to open file " << fileName << "\n";
     }
 }
 
+// -c<file>: packs the input into the binary trace format, records are 4 bytes when every value fits
+void writeBinaryTrace(string fileName) {
+    char type;
+    long value;
+    TraceHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.recordSize = 4;
+    header.numProcesses = processList.size();
+    header.numRecords = 0;
+    for (trace->rewind(); trace->next(type, value); ) {
+        if (value < 0 || value >= (1L << 30)) {
+            header.recordSize = 8;
+        }
+        header.numRecords++;
+    }
+    ofstream out(fileName, ios::binary);
+    if (!out.is_open()) {
+        cout << "Unable to open file " << fileName << "\n";
+        return;
+    }
+    out.write((const char*) &header, sizeof(header));
+    size_t written = sizeof(header);
+    for (auto it = processList.begin(); it != processList.end(); ++it) {
+        uint32_t numVma = (*it)->vmas.size();
+        out.write((const char*) &numVma, sizeof(numVma));
+        written = written + sizeof(numVma);
+        for (auto vma = (*it)->vmas.begin(); vma != (*it)->vmas.end(); ++vma) {
+            TraceVMA v = { vma->second->startVPage, vma->second->endVPage, vma->second->writeProtected, vma->second->fileMapped,
+                vma->second->object, vma->second->privateMapping, vma->second->hugePage };
+            out.write((const char*) &v, sizeof(v));
+            written = written + sizeof(v);
+        }
+    }
+    const char padding[8] = {0};
+    out.write(padding, ((written + 7) & ~(size_t) 7) - written);
+    for (trace->rewind(); trace->next(type, value); ) {
+        int64_t record = packRecord(type, value);
+        if (header.recordSize == 4) {
+            uint32_t packed = record;
+            out.write((const char*) &packed, sizeof(packed));
+        } else {
+            out.write((const char*) &record, sizeof(record));
+        }
+    }
+    out.close();
+}
+
 void readRandomFile(string fileName) {
     ifstream inputFile(fileName);
     bool firstLine = true;
@@ -415,6 +1498,8 @@ Pager* getPagingAlgorithm() {
         case 'e': return new NRU;
         case 'a': return new AGING;
         case 'w': return new WSET;
+        case 'o': return new OPT;
+        case 'l': return new LRU;
         default:
             return nullptr;
     }
@@ -422,14 +1507,91 @@ Pager* getPagingAlgorithm() {
 
 void readArguments(int argc, char** argv) {
     int opt;
-    while ((opt = getopt (argc, argv, "f:a:o:")) != -1) {
+    while ((opt = getopt (argc, argv, "f:a:o:m:t:c:k:p:z:j:h:n:H:q:")) != -1) {
         switch (opt) {
-            case 'f': 
-                FRAME_TABLE_SIZE = std::atoi(optarg);
+            case 'f': {
+                // a comma separated list of frame counts for parallel runs
+                stringstream counts(optarg);
+                string count;
+                while (getline(counts, count, ',')) {
+                    FRAME_COUNTS.push_back(min(std::atoi(count.c_str()), MAX_FRAME_TABLE_SIZE));
+                }
+                FRAME_TABLE_SIZE = min(std::atoi(optarg), MAX_FRAME_TABLE_SIZE);
                 break;
+            }
             case 'a':
+                // every letter is a pager for parallel runs
                 PAGING_ALGO_PARAM = optarg[0];
+                PAGING_ALGOS = optarg;
+                break;
+            case 'j':
+                // -j<threads>, 0 for one per core
+                PARALLEL_RUNS = std::atoi(optarg) > 0 ? std::atoi(optarg) : max(1, (int) thread::hardware_concurrency());
+                break;
+            case 'm':
+                MRC_MAX_FRAMES = std::atoi(optarg);
+                break;
+            case 'c':
+                CONVERT_FILE = optarg;
+                break;
+            case 'h':
+                PROFILE_FILE = optarg;
+                break;
+            case 'n':
+                // -n<nodes>[:<migrate after>]
+                sscanf(optarg, "%d:%d", &NUMA_NODES, &NUMA_MIGRATE);
+                NUMA_NODES = max(1, NUMA_NODES);
+                NUMA_MIGRATE = max(0, NUMA_MIGRATE);
+                break;
+            case 'H': {
+                // -H<pages>[:a], pages per huge page rounded down to a power of two, a makes every VMA without a shared object eligible
+                int pages = 0;
+                char flags[8] = "";
+                sscanf(optarg, "%d:%7s", &pages, flags);
+                HUGE_ORDER = 0;
+                while ((2 << HUGE_ORDER) <= pages) {
+                    HUGE_ORDER++;
+                }
+                HUGE_PAGE_SIZE = HUGE_ORDER > 0 ? 1 << HUGE_ORDER : 0;
+                HUGE_ALWAYS = std::strchr(flags, 'a') != nullptr;
+                break;
+            }
+            case 'q':
+                // -q<window>[:<low>[:<high>]], fault rates in percent of the window's references
+                sscanf(optarg, "%d:%d:%d", &PFF_WINDOW, &PFF_LOW, &PFF_HIGH);
+                PFF_WINDOW = max(0, PFF_WINDOW);
+                break;
+            case 'p':
+                // -p<pages> fixed readahead window, -pa<max> adaptive
+                READAHEAD_ADAPTIVE = optarg[0] == 'a';
+                READAHEAD_WINDOW = max(0, std::atoi(READAHEAD_ADAPTIVE ? optarg + 1 : optarg));
+                if (READAHEAD_ADAPTIVE && READAHEAD_WINDOW == 0) {
+                    READAHEAD_WINDOW = 16;
+                }
+                break;
+            case 'z':
+                // -z<frames>[:<ratio>], frames of the budget given to the compressed pool, pages per frame
+                sscanf(optarg, "%d:%d", &ZSWAP_FRAMES, &ZSWAP_RATIO);
+                ZSWAP_RATIO = max(1, ZSWAP_RATIO);
                 break;
+            case 'k': {
+                // -k<period>[:<low>[:<high>[:<batch>]]], watermarks default to 1/32 and 1/16 of the frames,
+                // the write-back batch to the high watermark
+                CLEANER_PERIOD = 0;
+                sscanf(optarg, "%d:%d:%d:%d", &CLEANER_PERIOD, &CLEANER_LOW, &CLEANER_HIGH, &CLEANER_BATCH);
+                break;
+            }
+            case 't': {
+                // -t<entries>[:<ways>[:<flags>]], flags a = ASID tagged instead of flushed, f = FIFO instead of LRU
+                int size = 64, ways = 4;
+                char flags[8] = "";
+                sscanf(optarg, "%d:%d:%7s", &size, &ways, flags);
+                TLB_SIZE = max(1, size);
+                TLB_WAYS = ways;
+                TLB_ASID = std::strchr(flags, 'a') != nullptr;
+                TLB_LRU = std::strchr(flags, 'f') == nullptr;
+                break;
+            }
             case 'o':
                 if (optarg != NULL && optarg != "") {
                     PRINT_PTE_EACH_INSTR = std::strchr(optarg, 'x') != nullptr ? true : false;
@@ -458,28 +1620,37 @@ void readArguments(int argc, char** argv) {
         }
 }
 
+void printPTE(long index, PTE* pte) {
+    writer << ' ' << index << ':' << (pte->referenced == 1 ? 'R' : '-') << (pte->modified == 1 ? 'M' : '-') << (pte->pagedOut == 1 ? 'S' : '-');
+}
+
+// the first PAGE_TABLE_SIZE pages are always listed, pages above that only while present or swapped out
 void printProcessPageTable(Process* proc) {
-    cout << "PT[" << proc->id << "]:";
+    writer << "PT[" << proc->id << "]:";
     for (int index = 0; index < PAGE_TABLE_SIZE; index++) {
-        if (proc->pte[index].existsVma == 0) {
-            cout << " *";
+        PTE* pte = proc->pageTable.getPTE(index);
+        if (pte == nullptr || pte->existsVma == 0) {
+            writer << " *";
         } else {
-            string out = std::to_string(index) + ":";
-            if (proc->pte[index].present == 0) {
-                if (proc->pte[index].pagedOut == 1) {
-                    cout << " #";
+            if (pte->present == 0) {
+                if (pte->pagedOut == 1) {
+                    writer << " #";
                 } else {
-                    cout << " *";
+                    writer << " *";
                 }
             } else {
-                out = out + (proc->pte[index].referenced == 1 ? "R" : "-");
-                out = out + (proc->pte[index].modified == 1 ? "M" : "-");
-                out = out + (proc->pte[index].pagedOut == 1 ? "S" : "-");
-                cout << " " << out;
+                printPTE(index, pte);
             }
         }
     }
-    cout << "\n";
+    proc->pageTable.forEachPTE([](long vpage, PTE* pte) {
+        if (vpage >= PAGE_TABLE_SIZE && pte->present == 1) {
+            printPTE(vpage, pte);
+        } else if (vpage >= PAGE_TABLE_SIZE && pte->pagedOut == 1) {
+            writer << " " << vpage << ":#";
+        }
+    });
+    writer << "\n";
 }
 
 void printProcessPageTables() {
@@ -489,21 +1660,43 @@ void printProcessPageTables() {
 }
 
 void printFrameTable() {
-    cout << "FT:";
+    writer << "FT:";
     for (auto frame = frameTable->frames.begin(); frame != frameTable->frames.end(); ++frame) {
         if ((*frame)->isMapped) {
-            cout << " " << (*frame)->processId << ":" << (*frame)->pageValue;
+            writer << " " << (*frame)->processId << ":" << (*frame)->pageValue;
         } else {
-            cout << " *";
+            writer << " *";
         }
     }
-    cout << "\n";
+    writer << "\n";
 }
 
 void printProcessStats(Process* proc) {
     ProcessStats* pstats = proc->pstats;
-    printf("PROC[%d]: U=%lu M=%lu I=%lu O=%lu FI=%lu FO=%lu Z=%lu SV=%lu SP=%lu\n",
+    printf("PROC[%d]: U=%lu M=%lu I=%lu O=%lu FI=%lu FO=%lu Z=%lu SV=%lu SP=%lu",
         proc->id, pstats->unmaps, pstats->maps, pstats->ins, pstats->outs, pstats->fins, pstats->fouts, pstats->zeros, pstats->segv, pstats->segprot);
+    if (tlb != nullptr) {
+        printf(" TH=%lu TM=%lu", pstats->tlbHits, pstats->tlbMisses);
+    }
+    if (READAHEAD_WINDOW > 0) {
+        printf(" PF=%lu PH=%lu", pstats->prefetches, pstats->prefetchHits);
+    }
+    if (ZSWAP_FRAMES > 0) {
+        printf(" ZS=%lu ZL=%lu", pstats->zstores, pstats->zloads);
+    }
+    if (SHARED_OBJECTS) {
+        printf(" SH=%lu CW=%lu", pstats->shares, pstats->cows);
+    }
+    if (NUMA_NODES > 1) {
+        printf(" RA=%lu RF=%lu MG=%lu", pstats->remoteAccesses, pstats->remoteFaults, pstats->migrations);
+    }
+    if (HUGE_PAGE_SIZE > 0) {
+        printf(" HP=%lu HS=%lu HF=%lu", pstats->hugeMaps, pstats->hugeSplits, pstats->hugeFallbacks);
+    }
+    if (PFF_WINDOW > 0) {
+        printf(" SU=%lu", pstats->suspensions);
+    }
+    printf("\n");
 }
 
 void printProcessStats() {
@@ -512,125 +1705,1042 @@ void printProcessStats() {
     }
 }
 
+// zswap-like compressed cache in front of swap. Dirty anonymous pages are compressed into it instead of
+// going OUT, a fault on a pooled page pays ZLOAD instead of IN. Loads are exclusive: the entry is freed
+// and the page comes back dirty, as the pool held its only current copy. When full, the least recently
+// stored entry is written back to swap at the usual OUT cost. The pool's frames are taken off the frame table.
+class ZswapPool {
+    private:
+    struct Entry {
+        PTE* pte;
+        list<long long>::iterator lru;
+    };
+    // keyed by getPageKey(), so an exiting process drops a contiguous range
+    map<long long, Entry> entries;
+    // most recent first
+    list<long long> lru;
+    size_t capacity;
+
+    void touch(Entry& entry, long long key) {
+        lru.erase(entry.lru);
+        lru.push_front(key);
+        entry.lru = lru.begin();
+    }
+
+    public:
+    // frames taken off the frame table
+    int frames;
+    unsigned long stores = 0, loads = 0, writebacks = 0;
+
+    ZswapPool(int frames, int ratio): capacity((size_t) max(frames, 1) * ratio), frames(frames) {}
+
+    void store(Process* process, long vpage, PTE* pte) {
+        if (PRINT_STEPS) { writer << " " << PageOperationText[ZSTORE] << "\n"; }
+        totalCost = totalCost + instrCostMap[ZSTORE];
+        process->pstats->zstores = process->pstats->zstores + 1;
+        stores++;
+        long long key = getPageKey(process->id, vpage);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            touch(it->second, key);
+            return;
+        }
+        if (entries.size() >= capacity) {
+            long long victimKey = lru.back();
+            lru.pop_back();
+            Process* owner = processList[victimKey >> PageTable::VPAGE_BITS];
+            Entry& victim = entries[victimKey];
+            if (PRINT_STEPS) { writer << " " << PageOperationText[OUT] << " " << owner->id << ":" << (victimKey & (PageTable::MAX_VPAGES - 1)) << "\n"; }
+            victim.pte->pagedOut = 1;
+            owner->pstats->outs = owner->pstats->outs + 1;
+            totalCost = totalCost + instrCostMap[OUT];
+            writebacks++;
+            entries.erase(victimKey);
+        }
+        lru.push_front(key);
+        Entry entry = { pte, lru.begin() };
+        entries[key] = entry;
+    }
+
+    bool load(Process* process, long vpage, PTE* pte) {
+        long long key = getPageKey(process->id, vpage);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            return false;
+        }
+        lru.erase(it->second.lru);
+        entries.erase(it);
+        pte->modified = 1;
+        if (PRINT_STEPS) { writer << " " << PageOperationText[ZLOAD] << "\n"; }
+        totalCost = totalCost + instrCostMap[ZLOAD];
+        process->pstats->zloads = process->pstats->zloads + 1;
+        loads++;
+        return true;
+    }
+
+    bool contains(Process* process, long vpage) {
+        return entries.find(getPageKey(process->id, vpage)) != entries.end();
+    }
+
+    void exitProcess(int pid) {
+        auto first = entries.lower_bound(getPageKey(pid, 0)), last = entries.lower_bound(getPageKey(pid + 1, 0));
+        for (auto it = first; it != last; ++it) {
+            lru.erase(it->second.lru);
+        }
+        entries.erase(first, last);
+    }
+
+    void reset() {
+        entries.clear();
+        lru.clear();
+        stores = 0, loads = 0, writebacks = 0;
+    }
+
+    // hit rate is pool loads over all loads of anonymous pages that had been evicted
+    void printStats(unsigned long long baseCost) {
+        unsigned long ins = 0;
+        for (auto it = processList.begin(); it != processList.end(); ++it) {
+            ins = ins + (*it)->pstats->ins;
+        }
+        printf("ZSWAP: capacity=%lu stores=%lu loads=%lu writebacks=%lu hitrate=%.4lf cost=%llu base=%llu net=%lld\n",
+            capacity, stores, loads, writebacks, loads + ins > 0 ? loads / (double) (loads + ins) : 0.0, totalCost, baseCost,
+            (long long) totalCost - (long long) baseCost);
+    }
+};
+
+thread_local ZswapPool* zswap = nullptr;
+
+// Fenwick tree over LRU stack slot keys, a slot is either a page or a hole left by an exited process.
+// The newest slot has the highest key, so a slot's stack depth is the number of slots with key >= its own.
+class StackSlots {
+    private:
+    vector<int> tree;
+    int total = 0;
+
+    public:
+    StackSlots(int maxKeys): tree(maxKeys + 1, 0) {}
+
+    void add(int key, int delta) {
+        total = total + delta;
+        for (int i = key; i < (int) tree.size(); i += i & (-i)) {
+            tree[i] = tree[i] + delta;
+        }
+    }
+
+    int getDepth(int key) {
+        int below = 0;
+        for (int i = key - 1; i > 0; i -= i & (-i)) {
+            below = below + tree[i];
+        }
+        return total - below;
+    }
+};
+
+// -h<file>: where the faults come from, as one record per line for plotting
+//   F <pid> <vpage> <faults>                   faults per page
+//   R <pid> <bucket> <references>              reuse distance histogram, the distance being the distinct pages referenced
+//                                              in between, bucket 0 holds distance 0, bucket b [2^(b-1), 2^b), -1 first uses
+//   V <pid> <start> <end> <zero> <in> <fin>    faults per VMA by kind, pool loads (-z) count as in
+//   W <inst> <pid> <pages> <faults>            per context switch interval, the working set and faults of the process that ran
+// Reuse distances are exact and taken over all processes, from a Fenwick tree over reference times as for the
+// LRU miss-ratio curve. The times are renumbered whenever they run out, so the tree stays a few times the number
+// of live pages and in cache however long the trace is. The W records are streamed.
+class FaultProfiler {
+    private:
+    struct PageUse {
+        int lastKey = 0;
+        unsigned long interval = ULONG_MAX;
+    };
+    struct VmaFaults {
+        unsigned long zeros = 0, ins = 0, fins = 0;
+    };
+    static const int BUCKETS = 34;
+    ofstream out;
+    int nextKey = 1, capacity = 1024;
+    StackSlots slots;
+    // by getPageKey(), looked up on every reference, an exit has to scan it but exits are rare
+    unordered_map<long long, PageUse> pages;
+    map<long long, unsigned long> pageFaults;
+    map<VMA*, VmaFaults> vmaFaults;
+    vector<vector<unsigned long>> reuse;
+    unsigned long interval = 0, intervalPages = 0, intervalFaults = 0;
+    int intervalProcess = -1;
+
+    void closeInterval() {
+        if (intervalProcess >= 0) {
+            out << "W " << instCount << " " << intervalProcess << " " << intervalPages << " " << intervalFaults << "\n";
+            intervals++;
+        }
+        interval++;
+        intervalPages = 0, intervalFaults = 0;
+    }
+
+    // gives the live pages keys 1..n in reference order
+    void compact() {
+        vector<pair<int, PageUse*>> live;
+        for (auto it = pages.begin(); it != pages.end(); ++it) {
+            if (it->second.lastKey != 0) {
+                live.push_back(make_pair(it->second.lastKey, &it->second));
+            }
+        }
+        sort(live.begin(), live.end());
+        capacity = max(1024, 4 * (int) live.size());
+        slots = StackSlots(capacity);
+        nextKey = 1;
+        for (auto it = live.begin(); it != live.end(); ++it) {
+            it->second->lastKey = nextKey++;
+            slots.add(it->second->lastKey, 1);
+        }
+    }
+
+    public:
+    unsigned long faults = 0, intervals = 0;
+
+    FaultProfiler(const string& fileName): out(fileName), slots(capacity), reuse(processList.size(), vector<unsigned long>(BUCKETS, 0)) {}
+
+    bool isOpen() { return out.is_open(); }
+
+    void contextSwitch(Process* next) {
+        closeInterval();
+        intervalProcess = next->id;
+    }
+
+    void reference(Process* process, long vpage) {
+        PageUse& use = pages[getPageKey(process->id, vpage)];
+        int bucket = -1;
+        if (use.lastKey != 0) {
+            int distance = slots.getDepth(use.lastKey) - 1;
+            bucket = distance == 0 ? 0 : 32 - __builtin_clz(distance);
+            slots.add(use.lastKey, -1);
+            use.lastKey = 0;
+        }
+        if (nextKey > capacity) {
+            compact();
+        }
+        use.lastKey = nextKey++;
+        slots.add(use.lastKey, 1);
+        reuse[process->id][bucket + 1]++;
+        if (use.interval != interval) {
+            use.interval = interval;
+            intervalPages++;
+        }
+    }
+
+    // kind is ZERO, IN, FIN or ZLOAD
+    void fault(Process* process, long vpage, PageOperation kind) {
+        faults++;
+        intervalFaults++;
+        pageFaults[getPageKey(process->id, vpage)]++;
+        VmaFaults& counts = vmaFaults[process->findVma(vpage)];
+        if (kind == ZERO) {
+            counts.zeros++;
+        } else if (kind == FIN) {
+            counts.fins++;
+        } else {
+            counts.ins++;
+        }
+    }
+
+    void exitProcess(int pid) {
+        for (auto it = pages.begin(); it != pages.end(); ) {
+            if ((it->first >> PageTable::VPAGE_BITS) == pid) {
+                slots.add(it->second.lastKey, -1);
+                it = pages.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void finish() {
+        closeInterval();
+        for (auto it = pageFaults.begin(); it != pageFaults.end(); ++it) {
+            out << "F " << (it->first >> PageTable::VPAGE_BITS) << " " << (it->first & (PageTable::MAX_VPAGES - 1)) << " " << it->second << "\n";
+        }
+        for (size_t pid = 0; pid < reuse.size(); pid++) {
+            for (int bucket = 0; bucket < BUCKETS; bucket++) {
+                if (reuse[pid][bucket] > 0) {
+                    out << "R " << pid << " " << bucket - 1 << " " << reuse[pid][bucket] << "\n";
+                }
+            }
+        }
+        for (auto proc = processList.begin(); proc != processList.end(); ++proc) {
+            for (auto vma = (*proc)->vmas.begin(); vma != (*proc)->vmas.end(); ++vma) {
+                VmaFaults& counts = vmaFaults[vma->second];
+                out << "V " << (*proc)->id << " " << vma->second->startVPage << " " << vma->second->endVPage << " " << counts.zeros
+                    << " " << counts.ins << " " << counts.fins << "\n";
+            }
+        }
+        out.close();
+    }
+
+    void printStats() {
+        printf("PROFILE: faults=%lu faultedpages=%lu intervals=%lu\n", faults, (unsigned long) pageFaults.size(), intervals);
+    }
+};
+
+// only for a single run, not with -m or -j
+thread_local FaultProfiler* profiler = nullptr;
+
+void writeBackPage(Process* process, long vpage, PTE* pte) {
+    if (pte->fileMapped == 1) {
+        if (PRINT_STEPS) { writer << " " << PageOperationText[FOUT] << "\n"; }
+        process->pstats->fouts = process->pstats->fouts + 1;
+        totalCost = totalCost + instrCostMap[FOUT];
+    } else if (zswap != nullptr) {
+        zswap->store(process, vpage, pte);
+    } else {
+        if (PRINT_STEPS) { writer << " " << PageOperationText[OUT] << "\n"; }
+        pte->pagedOut = 1;
+        process->pstats->outs = process->pstats->outs + 1;
+        totalCost = totalCost + instrCostMap[OUT];
+    }
+    pte->modified = 0;
+}
+
+// drops one mapping of a shared frame that stays mapped by the others
+void unmapSharer(FrameEntry* frame, int pid, long vpage) {
+    PTE* pte = nullptr;
+    if (frame->processId == pid && frame->pageValue == vpage) {
+        pte = frame->pte;
+        RMapEntry next = frame->sharers.back();
+        frame->sharers.pop_back();
+        processList[pid]->resident--;
+        processList[next.processId]->resident++;
+        frame->processId = next.processId;
+        frame->pageValue = next.vpage;
+        frame->pte = next.pte;
+    } else {
+        for (auto it = frame->sharers.begin(); it != frame->sharers.end(); ++it) {
+            if (it->processId == pid && it->vpage == vpage) {
+                pte = it->pte;
+                frame->sharers.erase(it);
+                break;
+            }
+        }
+    }
+    frame->sharedDirty = frame->sharedDirty || pte->modified == 1;
+    sharedMappings--;
+}
+
+// a huge page that loses one of its frames is split into base pages first, the others stay mapped
+void splitHugePage(FrameEntry* frame) {
+    FrameEntry* head = frameTable->frames[frame->hugeHead];
+    Process* owner = processList[head->processId];
+    if (PRINT_STEPS) { writer << " " << PageOperationText[SPLIT] << " " << head->frameId << "\n"; }
+    totalCost = totalCost + instrCostMap[SPLIT];
+    owner->pstats->hugeSplits = owner->pstats->hugeSplits + 1;
+    if (tlb != nullptr) { tlb->invalidate(owner->id, head->pageValue, true); }
+    for (int i = 0; i < HUGE_PAGE_SIZE; i++) {
+        frameTable->frames[head->frameId + i]->hugeHead = -1;
+    }
+}
+
 void clearVictimFrame(FrameEntry* frame) {
-    if (PRINT_STEPS) { cout << " " << PageOperationText[UNMAP] << " " << frame->processId << ":" << frame->pageValue << "\n"; }
+    if (frame->hugeHead >= 0) {
+        splitHugePage(frame);
+    }
+    // a shared frame is unmapped from every process, the first mapping last so it writes the page back
+    for (auto it = frame->sharers.begin(); it != frame->sharers.end(); ++it) {
+        if (PRINT_STEPS) { writer << " " << PageOperationText[UNMAP] << " " << it->processId << ":" << it->vpage << "\n"; }
+        totalCost = totalCost + instrCostMap[UNMAP];
+        processList[it->processId]->pstats->unmaps = processList[it->processId]->pstats->unmaps + 1;
+        if (tlb != nullptr) { tlb->invalidate(it->processId, it->vpage); }
+        frame->sharedDirty = frame->sharedDirty || it->pte->modified == 1;
+        it->pte->present = 0;
+        it->pte->referenced = 0;
+        it->pte->modified = 0;
+    }
+    sharedMappings = sharedMappings - frame->sharers.size();
+    frame->sharers.clear();
+    if (frame->objectKey >= 0) {
+        objectFrames.erase(frame->objectKey);
+        frame->objectKey = -1;
+    }
+    if (PRINT_STEPS) { writer << " " << PageOperationText[UNMAP] << " " << frame->processId << ":" << frame->pageValue << "\n"; }
     totalCost = totalCost + instrCostMap[UNMAP];
     Process* victimProcess = processList[frame->processId];
-    PTE* pte = &victimProcess->pte[frame->pageValue];
+    PTE* pte = frame->pte;
     pte->present = 0;
+    if (tlb != nullptr) { tlb->invalidate(frame->processId, frame->pageValue); }
     victimProcess->pstats->unmaps = victimProcess->pstats->unmaps + 1;
-    if (pte->modified == 1) {
-        if (pte->fileMapped == 1) {
-            if (PRINT_STEPS) { cout << " " << PageOperationText[FOUT] << "\n"; }
-            victimProcess->pstats->fouts = victimProcess->pstats->fouts + 1;
-            totalCost = totalCost + instrCostMap[FOUT];
-        } else {
-            if (PRINT_STEPS) { cout << " " << PageOperationText[OUT] << "\n"; }
-            pte->pagedOut = 1;
-            victimProcess->pstats->outs = victimProcess->pstats->outs + 1;
-            totalCost = totalCost + instrCostMap[OUT];
-        }
+    if (pte->modified == 1 || frame->sharedDirty) {
+        writeBackPage(victimProcess, frame->pageValue, pte);
     }
+    frame->sharedDirty = false;
     pte->referenced = 0;
     pte->modified = 0;
     frame->isMapped = false;
+    victimProcess->resident--;
 }
 
 void releaseFrames(Process* process) {
-    for (int index = 0; index < PAGE_TABLE_SIZE; index++) {
-        PTE* pte = &process->pte[index];
+    process->pageTable.forEachPTE([process](long vpage, PTE* pte) {
         if (pte->present == 1) {
             FrameEntry* frame = frameTable->frames[pte->frame];
-            if (PRINT_STEPS) { cout << " " << PageOperationText[UNMAP] << " " << frame->processId << ":" << frame->pageValue << "\n"; }
+            if (PRINT_STEPS) { writer << " " << PageOperationText[UNMAP] << " " << process->id << ":" << vpage << "\n"; }
             totalCost = totalCost + instrCostMap[UNMAP];
             process->pstats->unmaps = process->pstats->unmaps + 1;
-            frame->isMapped = false;
-            if (pte->modified == 1 && pte->fileMapped == 1) {
-                if (PRINT_STEPS) { cout << " " << PageOperationText[FOUT] << "\n"; }
-                process->pstats->fouts = process->pstats->fouts + 1;
-                totalCost = totalCost + instrCostMap[FOUT];
+            if (tlb != nullptr) { tlb->invalidate(process->id, vpage); }
+            if (frame->hugeHead == frame->frameId && tlb != nullptr) {
+                tlb->invalidate(process->id, vpage, true);
+            }
+            frame->hugeHead = -1;
+            if (!frame->sharers.empty()) {
+                // other processes keep the page
+                unmapSharer(frame, process->id, vpage);
+            } else {
+                frame->isMapped = false;
+                process->resident--;
+                if ((pte->modified == 1 || frame->sharedDirty) && pte->fileMapped == 1) {
+                    if (PRINT_STEPS) { writer << " " << PageOperationText[FOUT] << "\n"; }
+                    process->pstats->fouts = process->pstats->fouts + 1;
+                    totalCost = totalCost + instrCostMap[FOUT];
+                }
+                frame->sharedDirty = false;
+                if (frame->objectKey >= 0) {
+                    objectFrames.erase(frame->objectKey);
+                    frame->objectKey = -1;
+                }
+                frameTable->makeFrameAvailable(frame);
             }
-            frameTable->makeFrameAvailable(frame);
         }
         pte->present = 0;
         pte->pagedOut = 0;
         pte->referenced = 0;
         pte->modified = 0;
+    });
+    if (zswap != nullptr) { zswap->exitProcess(process->id); }
+}
+
+void attachFrame(FrameEntry* frame, PTE* pte, long vpage) {
+    frame->processId = CURRENT_PROCESS->id;
+    frame->pageValue = vpage;
+    frame->pte = pte;
+    frame->isMapped = true;
+    frame->prefetched = false;
+    frame->remoteRefs = 0;
+    frame->timeLastUse = instCount;
+    pte->present = 1;
+    pte->frame = frame->frameId;
+    CURRENT_PROCESS->resident++;
+}
+
+void chargeRemoteFault(FrameEntry* frame) {
+    if (frame->node != CURRENT_PROCESS->homeNode) {
+        if (PRINT_STEPS) { writer << " " << PageOperationText[RFAULT] << " " << frame->node << "\n"; }
+        totalCost = totalCost + instrCostMap[RFAULT];
+        CURRENT_PROCESS->pstats->remoteFaults = CURRENT_PROCESS->pstats->remoteFaults + 1;
     }
 }
 
-void loadNewFrame(FrameEntry* frame, PTE* pte, int vpage) {
+void mapFrame(FrameEntry* frame, PTE* pte, long vpage) {
+    if (PRINT_STEPS) { writer << " " << PageOperationText[MAP] << " " << frame->frameId << "\n"; }
+    attachFrame(frame, pte, vpage);
+    totalCost = totalCost + instrCostMap[MAP];
+    CURRENT_PROCESS->pstats->maps = CURRENT_PROCESS->pstats->maps + 1;
+    chargeRemoteFault(frame);
+}
+
+void loadNewFrame(FrameEntry* frame, PTE* pte, long vpage) {
+    PageOperation kind;
     if (pte->fileMapped == 1) {
-        if (PRINT_STEPS) { cout << " " << PageOperationText[FIN] << "\n"; }
+        if (PRINT_STEPS) { writer << " " << PageOperationText[FIN] << "\n"; }
         totalCost = totalCost + instrCostMap[FIN];
         CURRENT_PROCESS->pstats->fins = CURRENT_PROCESS->pstats->fins + 1;
+        kind = FIN;
+    } else if (zswap != nullptr && zswap->load(CURRENT_PROCESS, vpage, pte)) {
+        // decompressed from the pool
+        kind = ZLOAD;
     } else if (pte->pagedOut == 1) {
-        if (PRINT_STEPS) { cout << " " << PageOperationText[IN] << "\n"; }
+        if (PRINT_STEPS) { writer << " " << PageOperationText[IN] << "\n"; }
         totalCost = totalCost + instrCostMap[IN];
         CURRENT_PROCESS->pstats->ins = CURRENT_PROCESS->pstats->ins + 1;
+        kind = IN;
     } else {
-        if (PRINT_STEPS) { cout << " " << PageOperationText[ZERO] << "\n"; }
+        if (PRINT_STEPS) { writer << " " << PageOperationText[ZERO] << "\n"; }
         totalCost = totalCost + instrCostMap[ZERO];
         CURRENT_PROCESS->pstats->zeros = CURRENT_PROCESS->pstats->zeros + 1;
+        kind = ZERO;
     }
-
-    if (PRINT_STEPS) { cout << " " << PageOperationText[MAP] << " " << frame->frameId << "\n"; }
-    frame->processId = CURRENT_PROCESS->id;
-    frame->pageValue = vpage;
-    frame->isMapped = true;
-    pte->present = 1;
-    pte->frame = frame->frameId;
-    totalCost = totalCost + instrCostMap[MAP];
-    CURRENT_PROCESS->pstats->maps = CURRENT_PROCESS->pstats->maps + 1;
+    if (profiler != nullptr) { profiler->fault(CURRENT_PROCESS, vpage, kind); }
+    mapFrame(frame, pte, vpage);
 }
 
-void runSimulation() {
-    for (auto instr = instructions.begin(); instr != instructions.end(); instr++, instCount++) {
+// -q: local replacement under page-fault-frequency control. Every process starts with an equal share of the
+// frames as its quota. A process at its quota replaces one of its own pages, below it takes a free frame or,
+// without one, a frame of a process over its quota. After every window references of a process its quota
+// grows by a quarter when more than high percent of them faulted, and shrinks to the pages it referenced in
+// the window, going by the frames' last use times, when fewer than low percent did. The quotas never add up
+// to more than the frames, a process that has to grow when there are none left does not fit: it is suspended
+// when the trace switches away from it, its pages are swapped out and its quota goes back to the others, and
+// when it is switched to again it is resumed with what the others left of its old quota. Pages mapped ahead of
+// a fault, by readahead (-p) or with a huge page (-H), count against the quota as well and are only brought in
+// while it has room for them.
+class FrameQuotas {
+    private:
+    struct Share {
+        int quota = 0, savedQuota = 0;
+        bool suspended = false, exited = false, tooLarge = false;
+        unsigned long refs = 0, faults = 0, windowStart = 0;
+    };
+    int window, low, high;
+    vector<Share> shares;
+    // quotas of the processes that are neither suspended nor exited
+    int committed = 0;
+    Process* running = nullptr;
+
+    // what the victim selection leaves to the pager
+    void setVictimOwners(Process* process) {
+        frameTable->victimOwners.assign(processList.size(), 0);
+        if (process->resident >= shares[process->id].quota) {
+            frameTable->victimOwners[process->id] = 1;
+            return;
+        }
+        for (size_t i = 0; i < processList.size(); i++) {
+            frameTable->victimOwners[i] = processList[i]->resident > shares[i].quota ? 1 : 0;
+        }
+    }
+
+    bool hasVictimOwner() {
+        for (size_t i = 0; i < processList.size(); i++) {
+            if (frameTable->victimOwners[i] && processList[i]->resident > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // as much of want as the other quotas leave, at least one frame
+    void setQuota(Share& share, int want) {
+        int granted = max(1, min(want, FRAME_TABLE_SIZE - (committed - share.quota)));
+        committed = committed + granted - share.quota;
+        share.quota = granted;
+    }
+
+    void suspend(Process* process) {
+        Share& share = shares[process->id];
+        if (PRINT_STEPS) { writer << " SUSPEND " << process->id << "\n"; }
+        committed = committed - share.quota;
+        share.savedQuota = share.quota;
+        share.quota = 0;
+        share.suspended = true;
+        share.tooLarge = false;
+        process->pstats->suspensions = process->pstats->suspensions + 1;
+        suspensions++;
+        // swapped out, a shared page stays with its other mappings
+        process->pageTable.forEachPTE([process](long vpage, PTE* pte) {
+            if (pte->present == 0) {
+                return;
+            }
+            FrameEntry* frame = frameTable->frames[pte->frame];
+            if (frame->sharers.empty()) {
+                clearVictimFrame(frame);
+                frameTable->makeFrameAvailable(frame);
+                return;
+            }
+            if (PRINT_STEPS) { writer << " " << PageOperationText[UNMAP] << " " << process->id << ":" << vpage << "\n"; }
+            totalCost = totalCost + instrCostMap[UNMAP];
+            process->pstats->unmaps = process->pstats->unmaps + 1;
+            if (tlb != nullptr) { tlb->invalidate(process->id, vpage); }
+            unmapSharer(frame, process->id, vpage);
+            pte->present = 0;
+            pte->referenced = 0;
+            pte->modified = 0;
+        });
+    }
+
+    // the working set is taken over the window, from the last use times every reference refreshes
+    void adjust(Process* process) {
+        Share& share = shares[process->id];
+        if (share.faults * 100 > (unsigned long) high * share.refs) {
+            int quota = share.quota;
+            setQuota(share, quota + max(1, quota / 4));
+            grows = grows + (share.quota > quota ? 1 : 0);
+            share.tooLarge = share.quota == quota;
+        } else if (share.faults * 100 < (unsigned long) low * share.refs) {
+            int workingSet = 0;
+            for (auto it = frameTable->frames.begin(); it != frameTable->frames.end(); ++it) {
+                if ((*it)->isMapped && (*it)->processId == process->id && (unsigned long) (*it)->timeLastUse >= share.windowStart) {
+                    workingSet++;
+                }
+            }
+            if (workingSet < share.quota) {
+                setQuota(share, workingSet);
+                shrinks++;
+            }
+            share.tooLarge = false;
+        }
+        share.refs = 0, share.faults = 0, share.windowStart = instCount + 1;
+    }
+
+    public:
+    unsigned long grows = 0, shrinks = 0, suspensions = 0, resumes = 0;
+
+    FrameQuotas(int w, int lo, int hi): window(max(1, w)), low(lo), high(hi) {
+        reset();
+    }
+
+    bool hasRoom(Process* process, int frames) {
+        return process->resident + frames <= shares[process->id].quota;
+    }
+
+    // a frame for a fault of process, picked like FrameTable::getNextFrame() but within the quotas
+    FrameEntry* getFrame(Process* process) {
+        FrameEntry* fe = nullptr;
+        if (process->resident < shares[process->id].quota) {
+            fe = frameTable->takeFreeFrame(process->homeNode);
+        }
+        if (fe == nullptr) {
+            setVictimOwners(process);
+            // quotas of more processes than frames can leave nobody to take from, then any frame goes
+            frameTable->restricted = hasVictimOwner();
+            fe = frameTable->pager->getVictimFrame();
+            frameTable->restricted = false;
+        }
+        frameTable->pager->frameSelected(fe);
+        return fe;
+    }
+
+    void reference(Process* process, FrameEntry* frame, bool faulted) {
+        frame->timeLastUse = instCount;
+        Share& share = shares[process->id];
+        share.refs++;
+        share.faults = share.faults + (faulted ? 1 : 0);
+        if (share.refs >= (unsigned long) window) {
+            adjust(process);
+        }
+    }
+
+    void contextSwitch(Process* next) {
+        if (running != nullptr && running != next && shares[running->id].tooLarge && !shares[running->id].exited) {
+            suspend(running);
+        }
+        running = next;
+        Share& share = shares[next->id];
+        if (share.suspended) {
+            if (PRINT_STEPS) { writer << " RESUME " << next->id << "\n"; }
+            share.suspended = false;
+            resumes++;
+            setQuota(share, share.savedQuota);
+        }
+    }
+
+    void exitProcess(Process* process) {
+        Share& share = shares[process->id];
+        committed = committed - share.quota;
+        share.quota = 0;
+        share.exited = true;
+    }
+
+    void reset() {
+        shares.assign(processList.size(), Share());
+        int quota = max(1, FRAME_TABLE_SIZE / max(1, (int) processList.size()));
+        for (auto it = shares.begin(); it != shares.end(); ++it) {
+            it->quota = quota;
+        }
+        committed = quota * shares.size();
+        running = nullptr;
+        grows = 0, shrinks = 0, suspensions = 0, resumes = 0;
+    }
+
+    void printStats() {
+        printf("PFF: window=%d low=%d high=%d grows=%lu shrinks=%lu suspensions=%lu resumes=%lu quotas=", window, low, high, grows, shrinks,
+            suspensions, resumes);
+        for (size_t i = 0; i < shares.size(); i++) {
+            printf(i == 0 ? "%d" : ",%d", shares[i].quota);
+        }
+        printf("\n");
+    }
+};
+
+thread_local FrameQuotas* quotas = nullptr;
+
+// the frame for a fault of the current process, within its quota under -q
+FrameEntry* getFaultFrame() {
+    return quotas != nullptr ? quotas->getFrame(CURRENT_PROCESS) : frameTable->getNextFrame(CURRENT_PROCESS->homeNode);
+}
+
+// the private anonymous copy of a resident shared page, copied in memory at COW and one MAP
+void mapPrivateCopy(PTE* pte, long vpage) {
+    pte->fileMapped = 0;
+    if (PRINT_STEPS) { writer << " " << PageOperationText[COW] << "\n"; }
+    totalCost = totalCost + instrCostMap[COW];
+    CURRENT_PROCESS->pstats->cows = CURRENT_PROCESS->pstats->cows + 1;
+    FrameEntry* frame = getFaultFrame();
+    if (frame->isMapped) {
+        clearVictimFrame(frame);
+    }
+    mapFrame(frame, pte, vpage);
+}
+
+// A write to a shared page through a private mapping gets its own anonymous copy. The last mapping of the
+// page takes it over instead, nothing else can see it any more.
+void copyOnWrite(PTE* pte, long vpage) {
+    if (CURRENT_PROCESS->findVma(vpage)->privateMapping == 0) {
+        return;
+    }
+    FrameEntry* shared = frameTable->frames[pte->frame];
+    if (shared->sharers.empty()) {
+        if (shared->sharedDirty) {
+            writeBackPage(CURRENT_PROCESS, vpage, pte);
+            shared->sharedDirty = false;
+        }
+        objectFrames.erase(shared->objectKey);
+        shared->objectKey = -1;
+        pte->fileMapped = 0;
+        return;
+    }
+    unmapSharer(shared, CURRENT_PROCESS->id, vpage);
+    pte->present = 0;
+    mapPrivateCopy(pte, vpage);
+}
+
+// a file page of a shared object that some process already has resident is mapped without any I/O, a write
+// through a private mapping gets its copy right away instead of sharing the page first
+bool mapObjectPage(PTE* pte, long vpage, bool write) {
+    if (pte->fileMapped == 0) {
+        return false;
+    }
+    VMA* vma = CURRENT_PROCESS->findVma(vpage);
+    if (vma->object < 0) {
+        return false;
+    }
+    auto it = objectFrames.find(vma->getObjectKey(vpage));
+    if (it == objectFrames.end()) {
+        return false;
+    }
+    if (write && vma->privateMapping == 1 && pte->writeProtected == 0) {
+        mapPrivateCopy(pte, vpage);
+        return true;
+    }
+    FrameEntry* frame = it->second;
+    RMapEntry mapping = { CURRENT_PROCESS->id, vpage, pte };
+    frame->sharers.push_back(mapping);
+    sharedMappings++;
+    peakSharedMappings = max(peakSharedMappings, sharedMappings);
+    if (PRINT_STEPS) { writer << " " << PageOperationText[MAP] << " " << frame->frameId << "\n"; }
+    pte->present = 1;
+    pte->frame = frame->frameId;
+    totalCost = totalCost + instrCostMap[MAP];
+    CURRENT_PROCESS->pstats->maps = CURRENT_PROCESS->pstats->maps + 1;
+    CURRENT_PROCESS->pstats->shares = CURRENT_PROCESS->pstats->shares + 1;
+    return true;
+}
+
+void registerObjectPage(FrameEntry* frame, PTE* pte, long vpage) {
+    if (pte->fileMapped == 0) {
+        return;
+    }
+    VMA* vma = CURRENT_PROCESS->findVma(vpage);
+    if (vma->object >= 0) {
+        frame->objectKey = vma->getObjectKey(vpage);
+        objectFrames[frame->objectKey] = frame;
+    }
+}
+
+// kswapd-like background cleaner: wakes every period instructions, or as soon as free frames drop below
+// the low watermark, writes back up to batch dirty pages and, below low, reclaims frames through the pager
+// until high frames are free. Its operations are charged to bgCost instead of totalCost.
+class PageCleaner {
+    private:
+    int period, low, high, batch;
+    int hand = 0;
+    unsigned long sinceWakeup = 0;
+
+    public:
+    unsigned long wakeups = 0, cleaned = 0, reclaimed = 0;
+    unsigned long long bgCost = 0;
+
+    // a watermark < 0 is derived from the frame table size, a batch < 0 is the high watermark
+    PageCleaner(int p, int lo, int hi, int b): period(p), low(lo), high(hi), batch(b) {}
+
+    int lowMark() { return low >= 0 ? low : max(1, FRAME_TABLE_SIZE / 32); }
+    int highMark() { return high >= 0 ? high : max(lowMark() + 1, FRAME_TABLE_SIZE / 16); }
+    // dirty pages written back per wakeup
+    int writeBatch() { return batch >= 0 ? batch : highMark(); }
+
+    void tick() {
+        sinceWakeup++;
+        if ((period > 0 && sinceWakeup >= (unsigned long) period) || frameTable->getFreeCount() < lowMark()) {
+            wakeup();
+        }
+    }
+
+    void wakeup() {
+        unsigned long long foregroundCost = totalCost;
+        sinceWakeup = 0;
+        wakeups++;
+        if (PRINT_STEPS) { writer << " CLEANER\n"; }
+        int dirty = 0;
+        for (int count = 0; count < FRAME_TABLE_SIZE && dirty < writeBatch(); count++, hand = (hand + 1) % FRAME_TABLE_SIZE) {
+            FrameEntry* fe = frameTable->frames[hand];
+            if (fe->isMapped && isFrameModified(fe)) {
+                writeBackPage(processList[fe->processId], fe->pageValue, fe->pte);
+                clearFrameModified(fe);
+                cleaned++;
+                dirty++;
+            }
+        }
+        if (frameTable->getFreeCount() < lowMark()) {
+            while (frameTable->getFreeCount() < min(highMark(), FRAME_TABLE_SIZE)) {
+                FrameEntry* victim = frameTable->pager->getVictimFrame();
+                clearVictimFrame(victim);
+                frameTable->makeFrameAvailable(victim);
+                reclaimed++;
+            }
+        }
+        bgCost = bgCost + (totalCost - foregroundCost);
+        totalCost = foregroundCost;
+    }
+
+    void reset() {
+        hand = 0, sinceWakeup = 0, wakeups = 0, cleaned = 0, reclaimed = 0, bgCost = 0;
+    }
+
+    void printStats() {
+        printf("CLEANER: low=%d high=%d wakeups=%lu cleaned=%lu reclaimed=%lu fgcost=%llu bgcost=%llu\n",
+            lowMark(), highMark(), wakeups, cleaned, reclaimed, totalCost, bgCost);
+    }
+};
+
+thread_local PageCleaner* cleaner = nullptr;
+
+// the TLB, page cleaner, compressed pool and quotas of a run, whose frame count is already set
+void setupRunState(bool withZswap = true) {
+    if (TLB_SIZE > 0) {
+        tlb = new TLB(TLB_SIZE, TLB_WAYS, TLB_ASID, TLB_LRU);
+    }
+    if (CLEANER_PERIOD >= 0) {
+        cleaner = new PageCleaner(CLEANER_PERIOD, CLEANER_LOW, CLEANER_HIGH, CLEANER_BATCH);
+    }
+    if (ZSWAP_FRAMES > 0 && withZswap) {
+        // the pool lives in memory the frame table gives up
+        int poolFrames = min(ZSWAP_FRAMES, FRAME_TABLE_SIZE - 1);
+        FRAME_TABLE_SIZE = FRAME_TABLE_SIZE - poolFrames;
+        zswap = new ZswapPool(poolFrames, ZSWAP_RATIO);
+    }
+    if (PFF_WINDOW > 0) {
+        quotas = new FrameQuotas(PFF_WINDOW, PFF_LOW, PFF_HIGH);
+    }
+}
+
+void releaseRunState() {
+    delete tlb;
+    delete cleaner;
+    delete zswap;
+    delete quotas;
+    tlb = nullptr, cleaner = nullptr, zswap = nullptr, quotas = nullptr;
+}
+
+// Fault-around for file-mapped and swapped-out pages: the pages following vpage in its VMA that would need
+// the same kind of I/O are mapped into free frames, never evicting for it nor going over a -q quota, at MAP +
+// READAHEAD each. The adaptive window doubles when a fault continues where the last readahead ended and halves
+// otherwise.
+void readAhead(long vpage) {
+    int window = READAHEAD_WINDOW;
+    if (READAHEAD_ADAPTIVE) {
+        if (vpage == CURRENT_PROCESS->raNext) {
+            CURRENT_PROCESS->raWindow = max(1, min(2 * CURRENT_PROCESS->raWindow, READAHEAD_WINDOW));
+        } else {
+            CURRENT_PROCESS->raWindow = CURRENT_PROCESS->raWindow / 2;
+        }
+        window = CURRENT_PROCESS->raWindow;
+    }
+    VMA* vma = CURRENT_PROCESS->findVma(vpage);
+    long last = min(vpage + window, vma->endVPage);
+    CURRENT_PROCESS->raNext = vpage + 1;
+    for (long next = vpage + 1; next <= last && frameTable->hasFreeFrame(); next++) {
+        if (quotas != nullptr && !quotas->hasRoom(CURRENT_PROCESS, 1)) {
+            break;
+        }
+        PTE* pte = CURRENT_PROCESS->populatePTE(next);
+        if (pte->present == 1 || (pte->fileMapped == 0 && pte->pagedOut == 0) || (SHARED_OBJECTS && mapObjectPage(pte, next, false))) {
+            continue;
+        }
+        FrameEntry* frame = frameTable->takeFreeFrame(CURRENT_PROCESS->homeNode);
+        frameTable->pager->frameSelected(frame);
+        if (PRINT_STEPS) { writer << " " << PageOperationText[READAHEAD] << " " << next << "\n"; }
+        totalCost = totalCost + instrCostMap[READAHEAD];
+        CURRENT_PROCESS->pstats->prefetches = CURRENT_PROCESS->pstats->prefetches + 1;
+        mapFrame(frame, pte, next);
+        frame->prefetched = true;
+        if (SHARED_OBJECTS) { registerObjectPage(frame, pte, next); }
+        frameTable->pager->framePrefetched(frame);
+        CURRENT_PROCESS->raNext = next + 1;
+    }
+}
+
+// -H: the first fault in an aligned block of HUGE_PAGE_SIZE pages of an eligible VMA maps the whole block into
+// contiguous frames from the buddy allocator, at one MAP and one ZERO or FIN. The block must be untouched, and
+// without a free block of that size, memory being full or fragmented, the page faults in on its own. Under -q
+// the block's frames count against the quota, a block that does not fit in it is not mapped either.
+bool mapHugePage(PTE* pte, long vpage) {
+    VMA* vma = CURRENT_PROCESS->findVma(vpage);
+    long first = vpage & ~(long) (HUGE_PAGE_SIZE - 1);
+    if ((vma->hugePage == 0 && !HUGE_ALWAYS) || vma->object >= 0 || first < vma->startVPage || first + HUGE_PAGE_SIZE - 1 > vma->endVPage) {
+        return false;
+    }
+    vector<PTE*> block(HUGE_PAGE_SIZE);
+    for (int i = 0; i < HUGE_PAGE_SIZE; i++) {
+        block[i] = CURRENT_PROCESS->populatePTE(first + i);
+        if (block[i]->present == 1 || block[i]->pagedOut == 1 || (zswap != nullptr && zswap->contains(CURRENT_PROCESS, first + i))) {
+            return false;
+        }
+    }
+    if (quotas != nullptr && !quotas->hasRoom(CURRENT_PROCESS, HUGE_PAGE_SIZE)) {
+        return false;
+    }
+    FrameEntry* head = frameTable->takeFreeBlock(CURRENT_PROCESS->homeNode, HUGE_ORDER);
+    if (head == nullptr) {
+        CURRENT_PROCESS->pstats->hugeFallbacks = CURRENT_PROCESS->pstats->hugeFallbacks + 1;
+        return false;
+    }
+    PageOperation kind = pte->fileMapped == 1 ? FIN : ZERO;
+    if (PRINT_STEPS) { writer << " " << PageOperationText[kind] << "\n"; }
+    totalCost = totalCost + instrCostMap[kind];
+    if (kind == FIN) {
+        CURRENT_PROCESS->pstats->fins = CURRENT_PROCESS->pstats->fins + 1;
+    } else {
+        CURRENT_PROCESS->pstats->zeros = CURRENT_PROCESS->pstats->zeros + 1;
+    }
+    if (profiler != nullptr) { profiler->fault(CURRENT_PROCESS, vpage, kind); }
+    if (PRINT_STEPS) { writer << " " << PageOperationText[MAP] << " " << head->frameId << "-" << head->frameId + HUGE_PAGE_SIZE - 1 << "\n"; }
+    totalCost = totalCost + instrCostMap[MAP];
+    CURRENT_PROCESS->pstats->maps = CURRENT_PROCESS->pstats->maps + 1;
+    CURRENT_PROCESS->pstats->hugeMaps = CURRENT_PROCESS->pstats->hugeMaps + 1;
+    for (int i = 0; i < HUGE_PAGE_SIZE; i++) {
+        FrameEntry* frame = frameTable->frames[head->frameId + i];
+        frameTable->pager->frameSelected(frame);
+        attachFrame(frame, block[i], first + i);
+        frame->hugeHead = head->frameId;
+        // the faulting page is referenced by the caller, the rest came in unreferenced
+        if (first + i != vpage) {
+            frameTable->pager->framePrefetched(frame);
+        }
+    }
+    chargeRemoteFault(head);
+    return true;
+}
+
+// moves a page that keeps being referenced from another node into a free frame on its process's node, a
+// shared page stays where it is as its other mappings may be local to it
+void migratePage(FrameEntry* frame, PTE* pte, long vpage) {
+    if (!frame->sharers.empty() || frame->objectKey >= 0 || frame->hugeHead >= 0) {
+        return;
+    }
+    FrameEntry* target = frameTable->takeFreeFrame(CURRENT_PROCESS->homeNode, false);
+    if (target == nullptr) {
+        // retried on the next remote reference
+        return;
+    }
+    if (PRINT_STEPS) { writer << " " << PageOperationText[MIGRATE] << " " << frame->frameId << " " << target->frameId << "\n"; }
+    totalCost = totalCost + instrCostMap[MIGRATE];
+    CURRENT_PROCESS->pstats->migrations = CURRENT_PROCESS->pstats->migrations + 1;
+    if (tlb != nullptr) { tlb->invalidate(CURRENT_PROCESS->id, vpage); }
+    frameTable->pager->frameSelected(target);
+    target->processId = frame->processId;
+    target->pageValue = frame->pageValue;
+    target->pte = pte;
+    target->isMapped = true;
+    target->prefetched = frame->prefetched;
+    target->remoteRefs = 0;
+    pte->frame = target->frameId;
+    frame->isMapped = false;
+    frame->prefetched = false;
+    frame->remoteRefs = 0;
+    frameTable->makeFrameAvailable(frame);
+}
+
+// -n: a reference to a page on another node pays RACCESS on top
+void accessRemotePage(FrameEntry* frame, PTE* pte, long vpage) {
+    if (PRINT_STEPS) { writer << " " << PageOperationText[RACCESS] << " " << frame->node << "\n"; }
+    totalCost = totalCost + instrCostMap[RACCESS];
+    CURRENT_PROCESS->pstats->remoteAccesses = CURRENT_PROCESS->pstats->remoteAccesses + 1;
+    frame->remoteRefs++;
+    if (NUMA_MIGRATE > 0 && frame->remoteRefs >= (unsigned int) NUMA_MIGRATE) {
+        migratePage(frame, pte, vpage);
+    }
+}
+
+// One instantiation per pager, so the per-reference pager hook is a direct call, and per output mode:
+// without any of the per-instruction printouts (-oOxyf) the loop has no checks for them at all.
+template<bool VERBOSE, typename P> void runSimulation(P* pager) {
+    char instType;
+    long vpage;
+    for (trace->rewind(); trace->next(instType, vpage); instCount++) {
         bool printPTE = true;
-        char instType = (*instr)->instrType;
-        int vpage = (*instr)->value;
-        if (PRINT_STEPS) { cout << instCount << ": ==> " << instType << " " << vpage << "\n"; }
+        if (VERBOSE && PRINT_STEPS) { writer << instCount << ": ==> " << instType << " " << vpage << "\n"; }
         switch (instType) {
             case 'c':
                 CURRENT_PROCESS = processList[vpage];
-                if (! CURRENT_PROCESS->loadedBefore) {
-                    CURRENT_PROCESS->loadPTEFromVMAs();
-                    CURRENT_PROCESS->loadedBefore = true;
-                }
+                if (profiler != nullptr) { profiler->contextSwitch(CURRENT_PROCESS); }
+                if (quotas != nullptr) { quotas->contextSwitch(CURRENT_PROCESS); }
                 ctxSwitches++;
                 totalCost = totalCost + instrCostMap[CONTEXT_SWITCH];
+                if (tlb != nullptr) { tlb->contextSwitch(); }
                 printPTE = false;
                 break;
             case 'e':
-                /*if (PRINT_STEPS) {*/ cout << "EXIT current process " << CURRENT_PROCESS->id << "\n"; //}
+                if (PRINT_EXITS) { writer << "EXIT current process " << CURRENT_PROCESS->id << "\n"; }
                 processExits++;
                 totalCost = totalCost + instrCostMap[EXIT];
                 releaseFrames(CURRENT_PROCESS);
+                if (profiler != nullptr) { profiler->exitProcess(CURRENT_PROCESS->id); }
+                if (quotas != nullptr) { quotas->exitProcess(CURRENT_PROCESS); }
                 printPTE = false;
                 break;
             case 'r':
             case 'w':
-                PTE* pte = &CURRENT_PROCESS->pte[vpage];
                 totalCost = totalCost + instrCostMap[READ];
-                if (pte->present == 0) {
-                    if (pte->existsVma == 0) {
-                        if (PRINT_STEPS) { cout << " " << PageOperationText[SEGV] << "\n"; }
+                // a TLB hit skips the page walk, entries are only valid while the page is present
+                bool tlbMiss = tlb != nullptr && !tlb->lookup(CURRENT_PROCESS, vpage);
+                PTE* pte = CURRENT_PROCESS->pageTable.getPTE(vpage);
+                bool faulted = pte == nullptr || pte->present == 0;
+                if (faulted) {
+                    pte = CURRENT_PROCESS->populatePTE(vpage);
+                    if (pte == nullptr) {
+                        if (VERBOSE && PRINT_STEPS) { writer << " " << PageOperationText[SEGV] << "\n"; }
                         totalCost = totalCost + instrCostMap[SEGV];
                         CURRENT_PROCESS->pstats->segv = CURRENT_PROCESS->pstats->segv + 1;
                         printPTE = false;
                         break;
                     }
                     
-                    FrameEntry* victimFrame = frameTable->getNextFrame();
-                    if (victimFrame->isMapped && (victimFrame->processId != CURRENT_PROCESS->id || victimFrame->pageValue != vpage)) {
-                        clearVictimFrame(victimFrame);
+                    if (SHARED_OBJECTS && mapObjectPage(pte, vpage, instType == 'w')) {
+                        // minor fault on a page another process has resident
+                    } else if (HUGE_PAGE_SIZE > 0 && mapHugePage(pte, vpage)) {
+                        // the rest of its block came in with it
+                    } else {
+                        FrameEntry* victimFrame = getFaultFrame();
+                        if (victimFrame->isMapped && (victimFrame->processId != CURRENT_PROCESS->id || victimFrame->pageValue != vpage)) {
+                            clearVictimFrame(victimFrame);
+                        }
+                        bool needsIO = pte->fileMapped == 1 || pte->pagedOut == 1;
+                        loadNewFrame(victimFrame, pte, vpage);
+                        if (SHARED_OBJECTS) { registerObjectPage(victimFrame, pte, vpage); }
+                        if (READAHEAD_WINDOW > 0 && needsIO) {
+                            readAhead(vpage);
+                        }
                     }
-                    loadNewFrame(victimFrame, pte, vpage);
+                } else if (READAHEAD_WINDOW > 0 && frameTable->frames[pte->frame]->prefetched) {
+                    frameTable->frames[pte->frame]->prefetched = false;
+                    CURRENT_PROCESS->pstats->prefetchHits = CURRENT_PROCESS->pstats->prefetchHits + 1;
+                }
+                if (profiler != nullptr) { profiler->reference(CURRENT_PROCESS, vpage); }
+                if (SHARED_OBJECTS && instType == 'w' && pte->writeProtected == 0 && frameTable->frames[pte->frame]->objectKey >= 0) {
+                    copyOnWrite(pte, vpage);
                 }
+                if (NUMA_NODES > 1 && frameTable->frames[pte->frame]->node != CURRENT_PROCESS->homeNode) {
+                    accessRemotePage(frameTable->frames[pte->frame], pte, vpage);
+                }
+                if (quotas != nullptr) { quotas->reference(CURRENT_PROCESS, frameTable->frames[pte->frame], faulted); }
+                if (tlbMiss) { tlb->insert(CURRENT_PROCESS, vpage, HUGE_PAGE_SIZE > 0 && frameTable->frames[pte->frame]->hugeHead >= 0); }
+                pager->frameReferenced(frameTable->frames[pte->frame]);
                 pte->referenced = 1;
                 if (instType == 'w') {
                     if (pte->writeProtected == 1) {
-                        if (PRINT_STEPS) { cout << " " << PageOperationText[SEGPROT] << "\n"; }
+                        if (VERBOSE && PRINT_STEPS) { writer << " " << PageOperationText[SEGPROT] << "\n"; }
                         totalCost = totalCost + instrCostMap[SEGPROT];
                         CURRENT_PROCESS->pstats->segprot = CURRENT_PROCESS->pstats->segprot + 1;
                         break;
@@ -640,35 +2750,558 @@ void runSimulation() {
                 }
                 break;
         }
-        if (PRINT_ALL_PTE &&  printPTE) {
-            printProcessPageTables();
-        } else if (PRINT_PTE_EACH_INSTR &&  printPTE) {
-            printProcessPageTable(CURRENT_PROCESS);
+        if (cleaner != nullptr) { cleaner->tick(); }
+        if (VERBOSE) {
+            if (PRINT_ALL_PTE &&  printPTE) {
+                printProcessPageTables();
+            } else if (PRINT_PTE_EACH_INSTR &&  printPTE) {
+                printProcessPageTable(CURRENT_PROCESS);
+            }
+            if (PRINT_FTE_EACH_INSTR && printPTE) {
+                printFrameTable();
+            }
+        }
+    }
+}
+
+template<bool VERBOSE> void runSimulation() {
+    Pager* pager = frameTable->pager;
+    switch (PAGING_ALGO_PARAM) {
+        case 'f': runSimulation<VERBOSE>(static_cast<FIFO*>(pager)); break;
+        case 'r': runSimulation<VERBOSE>(static_cast<RANDOM*>(pager)); break;
+        case 'c': runSimulation<VERBOSE>(static_cast<CLOCK*>(pager)); break;
+        case 'e': runSimulation<VERBOSE>(static_cast<NRU*>(pager)); break;
+        case 'a': runSimulation<VERBOSE>(static_cast<AGING*>(pager)); break;
+        case 'w': runSimulation<VERBOSE>(static_cast<WSET*>(pager)); break;
+        case 'o': runSimulation<VERBOSE>(static_cast<OPT*>(pager)); break;
+        case 'l': runSimulation<VERBOSE>(static_cast<LRU*>(pager)); break;
+        default: runSimulation<VERBOSE>(pager); break;
+    }
+}
+
+void runSimulation() {
+    if (PRINT_STEPS || PRINT_ALL_PTE || PRINT_PTE_EACH_INSTR || PRINT_FTE_EACH_INSTR) {
+        runSimulation<true>();
+    } else {
+        runSimulation<false>();
+    }
+}
+
+void printMissRatio(int frames, unsigned long long faults, unsigned long references, unsigned long long cost) {
+    printf("MRC: %d %llu %.4lf %llu\n", frames, faults, references > 0 ? faults / (double) references : 0.0, cost);
+}
+
+struct StackPage {
+    int key = -1, dirtyFrom = INT_MAX;
+    PTE* pte = nullptr;
+    // frame counts at which the page has been paged out, as disjoint [start, end) ranges
+    map<int, int> pagedOut;
+};
+
+// One-pass miss-ratio curve for exact LRU (Mattson's stack algorithm). With f frames a reference hits
+// iff its stack depth d <= f, so every per-operation count is a range of frame counts, collected in
+// difference arrays. A page is modified at f frames iff f >= dirtyFrom, a write sets it to 1 and a
+// reload at every f < d pushes it up to d. Exits leave holes in the stack that later faults fill
+// before anything is pushed down, exactly like frames returned to the free list.
+class LRUStackAnalysis {
+    private:
+    int maxFrames, nextKey = 1;
+    StackSlots slots;
+    set<int> holes;
+    // keyed by getPageKey(), so one process's pages are contiguous
+    map<long long, StackPage> pages;
+    vector<long long> maps, ins, fins, unmaps, outs, fouts;
+
+    void addRange(vector<long long>& counts, int from, int to) {
+        from = max(from, 1);
+        to = min(to, maxFrames + 1);
+        if (from < to) {
+            counts[from]++;
+            counts[to]--;
+        }
+    }
+
+    void addPagedOut(StackPage& page, int from, int to) {
+        if (from >= to) {
+            return;
+        }
+        auto it = page.pagedOut.upper_bound(from);
+        if (it != page.pagedOut.begin() && prev(it)->second >= from) {
+            it = prev(it);
+        }
+        while (it != page.pagedOut.end() && it->first <= to) {
+            from = min(from, it->first);
+            to = max(to, it->second);
+            it = page.pagedOut.erase(it);
+        }
+        page.pagedOut[from] = to;
+    }
+
+    // the page sank from depth 1 to depth d since it was last touched: it was evicted once at every f < d
+    void chargeEvictions(StackPage& page, PTE* pte, int depth) {
+        addRange(unmaps, 1, depth);
+        if (page.dirtyFrom < depth) {
+            if (pte->fileMapped == 1) {
+                addRange(fouts, page.dirtyFrom, depth);
+            } else {
+                addRange(outs, page.dirtyFrom, depth);
+                addPagedOut(page, page.dirtyFrom, depth);
+            }
+        }
+    }
+
+    public:
+    LRUStackAnalysis(int maxFrames, int maxKeys): maxFrames(maxFrames), slots(maxKeys),
+        maps(maxFrames + 2, 0), ins(maxFrames + 2, 0), fins(maxFrames + 2, 0), unmaps(maxFrames + 2, 0), outs(maxFrames + 2, 0), fouts(maxFrames + 2, 0) {}
+
+    void reference(long long pageKey, PTE* pte, bool write) {
+        StackPage& page = pages[pageKey];
+        page.pte = pte;
+        int depth = page.key == -1 ? INT_MAX : slots.getDepth(page.key);
+        if (page.key != -1) {
+            chargeEvictions(page, pte, depth);
+        }
+        addRange(maps, 1, depth);
+        if (pte->fileMapped == 1) {
+            addRange(fins, 1, depth);
+        } else {
+            for (auto it = page.pagedOut.begin(); it != page.pagedOut.end() && it->first < depth; ++it) {
+                addRange(ins, it->first, min(it->second, depth));
+            }
+        }
+        page.dirtyFrom = write ? 1 : (page.dirtyFrom == INT_MAX ? INT_MAX : max(page.dirtyFrom, depth));
+
+        // a hole above the page is a free frame: it absorbs the push-down and the page's old slot becomes the hole
+        if (! holes.empty() && (page.key == -1 || *holes.rbegin() > page.key)) {
+            slots.add(*holes.rbegin(), -1);
+            holes.erase(prev(holes.end()));
+            if (page.key != -1) {
+                holes.insert(page.key);
+            }
+        } else if (page.key != -1) {
+            slots.add(page.key, -1);
+        }
+        page.key = nextKey++;
+        slots.add(page.key, 1);
+    }
+
+    void exitProcess(int pid) {
+        auto first = pages.lower_bound(getPageKey(pid, 0)), last = pages.lower_bound(getPageKey(pid + 1, 0));
+        for (auto it = first; it != last; ++it) {
+            StackPage& page = it->second;
+            if (page.key != -1) {
+                int depth = slots.getDepth(page.key);
+                chargeEvictions(page, page.pte, depth);
+                addRange(unmaps, depth, INT_MAX);
+                if (page.pte->fileMapped == 1) {
+                    addRange(fouts, max(depth, page.dirtyFrom), INT_MAX);
+                }
+                holes.insert(page.key);
+            }
+        }
+        pages.erase(first, last);
+    }
+
+    // pages still in the stack at the end were evicted at every f below their depth
+    void finish() {
+        for (auto it = pages.begin(); it != pages.end(); ++it) {
+            if (it->second.key != -1) {
+                chargeEvictions(it->second, it->second.pte, slots.getDepth(it->second.key));
+            }
+        }
+    }
+
+    void printCurve(unsigned long long baseCost, unsigned long references) {
+        long long m = 0, in = 0, fin = 0, unmap = 0, out = 0, fout = 0;
+        for (int f = 1; f <= maxFrames; f++) {
+            m = m + maps[f]; in = in + ins[f]; fin = fin + fins[f]; unmap = unmap + unmaps[f]; out = out + outs[f]; fout = fout + fouts[f];
+            unsigned long long cost = baseCost + m * instrCostMap[MAP] + in * instrCostMap[IN] + fin * instrCostMap[FIN] + (m - in - fin) * instrCostMap[ZERO]
+                + unmap * instrCostMap[UNMAP] + out * instrCostMap[OUT] + fout * instrCostMap[FOUT];
+            printMissRatio(f, m, references, cost);
+        }
+    }
+};
+
+// the stack analysis only models demand paging, options that change what a reference costs need the reruns
+bool lruStackAnalysisApplies() {
+    return TLB_SIZE == 0 && CLEANER_PERIOD < 0 && READAHEAD_WINDOW == 0 && ZSWAP_FRAMES == 0 && !SHARED_OBJECTS
+        && NUMA_NODES == 1 && HUGE_PAGE_SIZE == 0 && PFF_WINDOW == 0;
+}
+
+void runLRUMissRatioCurve() {
+    LRUStackAnalysis stack(MRC_MAX_FRAMES, trace->size() + 1);
+    unsigned long long baseCost = 0;
+    unsigned long references = 0;
+    char instType;
+    long vpage;
+    for (trace->rewind(); trace->next(instType, vpage); ) {
+        switch (instType) {
+            case 'c':
+                CURRENT_PROCESS = processList[vpage];
+                baseCost = baseCost + instrCostMap[CONTEXT_SWITCH];
+                break;
+            case 'e':
+                baseCost = baseCost + instrCostMap[EXIT];
+                stack.exitProcess(CURRENT_PROCESS->id);
+                break;
+            case 'r':
+            case 'w':
+                PTE* pte = CURRENT_PROCESS->populatePTE(vpage);
+                baseCost = baseCost + instrCostMap[READ];
+                references++;
+                if (pte == nullptr) {
+                    baseCost = baseCost + instrCostMap[SEGV];
+                    break;
+                }
+                if (instType == 'w' && pte->writeProtected == 1) {
+                    baseCost = baseCost + instrCostMap[SEGPROT];
+                }
+                stack.reference(getPageKey(CURRENT_PROCESS->id, vpage), pte, instType == 'w' && pte->writeProtected == 0);
+                break;
         }
-        if (PRINT_FTE_EACH_INSTR && printPTE) {
-            printFrameTable();
+    }
+    stack.finish();
+    stack.printCurve(baseCost, references);
+}
+
+void resetSimulation() {
+    for (auto it = processList.begin(); it != processList.end(); ++it) {
+        (*it)->pageTable.clear();
+        *(*it)->pstats = ProcessStats();
+        (*it)->raWindow = 1;
+        (*it)->raNext = -1;
+        (*it)->resident = 0;
+    }
+    CURRENT_PROCESS = nullptr;
+    instCount = 0, ctxSwitches = 0, processExits = 0, totalCost = 0;
+    RAND_OFFSET = 0;
+    if (tlb != nullptr) { tlb->reset(); }
+    if (cleaner != nullptr) { cleaner->reset(); }
+    if (zswap != nullptr) { zswap->reset(); }
+    if (quotas != nullptr) { quotas->reset(); }
+    objectFrames.clear();
+    sharedMappings = 0, peakSharedMappings = 0;
+}
+
+// pagers without the stack property are simply rerun for every frame count over the decoded trace
+void runPagerMissRatioCurve() {
+    int maxFrames = min(MRC_MAX_FRAMES, MAX_FRAME_TABLE_SIZE);
+    unsigned long references = 0;
+    char instType;
+    long vpage;
+    for (trace->rewind(); trace->next(instType, vpage); ) {
+        if (instType == 'r' || instType == 'w') {
+            references++;
+        }
+    }
+    for (int frames = 1; frames <= maxFrames; frames++) {
+        // a fresh run state per frame count, the zswap pool is carved out of it and quotas are shares of the rest
+        FRAME_TABLE_SIZE = frames;
+        setupRunState();
+        resetSimulation();
+        frameTable = new FrameTable(FRAME_TABLE_SIZE, getPagingAlgorithm());
+        runSimulation();
+        unsigned long long faults = 0;
+        for (auto it = processList.begin(); it != processList.end(); ++it) {
+            // pages mapped by readahead did not fault
+            faults = faults + (*it)->pstats->maps - (*it)->pstats->prefetches;
+        }
+        printMissRatio(frames, faults, references, totalCost);
+        for (auto it = frameTable->frames.begin(); it != frameTable->frames.end(); ++it) {
+            delete *it;
         }
+        delete frameTable->pager;
+        delete frameTable;
+        releaseRunState();
+    }
+}
+
+void printSharingStats() {
+    unsigned long sharedFrames = 0;
+    for (auto it = objectFrames.begin(); it != objectFrames.end(); ++it) {
+        sharedFrames = sharedFrames + (it->second->sharers.empty() ? 0 : 1);
+    }
+    printf("SHARING: objectpages=%lu sharedframes=%lu saved=%lu peaksaved=%lu\n", (unsigned long) objectFrames.size(), sharedFrames,
+        sharedMappings, peakSharedMappings);
+}
+
+void printNumaStats() {
+    vector<int> resident(NUMA_NODES, 0), size(NUMA_NODES, 0);
+    for (auto it = frameTable->frames.begin(); it != frameTable->frames.end(); ++it) {
+        size[(*it)->node]++;
+        resident[(*it)->node] = resident[(*it)->node] + ((*it)->isMapped ? 1 : 0);
+    }
+    unsigned long remoteAccesses = 0, remoteFaults = 0, migrations = 0;
+    for (auto it = processList.begin(); it != processList.end(); ++it) {
+        remoteAccesses = remoteAccesses + (*it)->pstats->remoteAccesses;
+        remoteFaults = remoteFaults + (*it)->pstats->remoteFaults;
+        migrations = migrations + (*it)->pstats->migrations;
+    }
+    printf("NUMA: nodes=%d", NUMA_NODES);
+    for (int node = 0; node < NUMA_NODES; node++) {
+        printf(" node%d=%d/%d", node, resident[node], size[node]);
     }
+    printf(" remoteaccesses=%lu remotefaults=%lu migrations=%lu\n", remoteAccesses, remoteFaults, migrations);
+}
+
+// fallbacks are the faults fragmentation kept from a huge page, freeblocks the huge pages that would fit now
+void printHugePageStats() {
+    unsigned long maps = 0, splits = 0, fallbacks = 0;
+    for (auto it = processList.begin(); it != processList.end(); ++it) {
+        maps = maps + (*it)->pstats->hugeMaps;
+        splits = splits + (*it)->pstats->hugeSplits;
+        fallbacks = fallbacks + (*it)->pstats->hugeFallbacks;
+    }
+    int resident = 0;
+    for (auto it = frameTable->frames.begin(); it != frameTable->frames.end(); ++it) {
+        resident = resident + ((*it)->hugeHead == (*it)->frameId ? 1 : 0);
+    }
+    printf("HUGE: pages=%d maps=%lu splits=%lu fallbacks=%lu resident=%d free=%d freeblocks=%d\n", HUGE_PAGE_SIZE, maps, splits, fallbacks,
+        resident, frameTable->getFreeCount(), frameTable->getFreeBlocks(HUGE_ORDER));
 }
 
 void printSimulationStats() {
     printf("TOTALCOST %lu %lu %lu %llu %lu\n", instCount, ctxSwitches, processExits, totalCost, sizeof(PTE));
 }
 
+// turns off the per-instruction printouts (-oOxyfa) and EXIT lines for reruns nobody reads
+void silenceSimulation() {
+    PRINT_STEPS = false, PRINT_EXITS = false, PRINT_PTE_EACH_INSTR = false, PRINT_ALL_PTE = false, PRINT_FTE_EACH_INSTR = false, PRINT_ASELECT = false;
+}
+
+// processes with the ids and VMAs of the given ones and nothing mapped yet
+vector<Process*> newProcesses(const vector<Process*>& processes) {
+    vector<Process*> fresh;
+    for (auto it = processes.begin(); it != processes.end(); ++it) {
+        Process* proc = new Process((*it)->id, new ProcessStats());
+        proc->vmas = (*it)->vmas;
+        fresh.push_back(proc);
+    }
+    return fresh;
+}
+
+// reruns the trace with the pool's frames given back to the frame table, for the net cost on the ZSWAP line.
+// The rerun gets its own processes, frames and TLB, cleaner and quotas, the finished run's are put back
+// untouched for the final reports. The caller silences the printouts first, -j workers share the flags.
+unsigned long long runWithoutZswap() {
+    unsigned long savedInstCount = instCount, savedCtxSwitches = ctxSwitches, savedProcessExits = processExits;
+    unsigned long long savedCost = totalCost;
+    unsigned long savedSharedMappings = sharedMappings, savedPeakSharedMappings = peakSharedMappings;
+    int savedFrameTableSize = FRAME_TABLE_SIZE;
+    vector<Process*> savedProcesses = processList;
+    FrameTable* savedFrameTable = frameTable;
+    TLB* savedTlb = tlb;
+    PageCleaner* savedCleaner = cleaner;
+    ZswapPool* savedZswap = zswap;
+    FrameQuotas* savedQuotas = quotas;
+    FaultProfiler* savedProfiler = profiler;
+    map<long long, FrameEntry*> savedObjectFrames;
+    savedObjectFrames.swap(objectFrames);
+    Process* savedCurrentProcess = CURRENT_PROCESS;
+
+    processList = newProcesses(savedProcesses);
+    FRAME_TABLE_SIZE = savedFrameTableSize + savedZswap->frames;
+    tlb = nullptr, cleaner = nullptr, zswap = nullptr, quotas = nullptr, profiler = nullptr;
+    setupRunState(false);
+    resetSimulation();
+    frameTable = new FrameTable(FRAME_TABLE_SIZE, getPagingAlgorithm());
+    runSimulation();
+    unsigned long long baseCost = totalCost;
+
+    for (auto it = frameTable->frames.begin(); it != frameTable->frames.end(); ++it) {
+        delete *it;
+    }
+    delete frameTable->pager;
+    delete frameTable;
+    releaseRunState();
+    for (auto it = processList.begin(); it != processList.end(); ++it) {
+        (*it)->pageTable.clear();
+        delete (*it)->pstats;
+        delete *it;
+    }
+    objectFrames.clear();
+
+    processList = savedProcesses, frameTable = savedFrameTable, FRAME_TABLE_SIZE = savedFrameTableSize;
+    tlb = savedTlb, cleaner = savedCleaner, zswap = savedZswap, quotas = savedQuotas, profiler = savedProfiler;
+    objectFrames.swap(savedObjectFrames);
+    sharedMappings = savedSharedMappings, peakSharedMappings = savedPeakSharedMappings;
+    instCount = savedInstCount, ctxSwitches = savedCtxSwitches, processExits = savedProcessExits, totalCost = savedCost;
+    CURRENT_PROCESS = savedCurrentProcess;
+    return baseCost;
+}
+
+void printFinalReports(unsigned long long zswapBaseCost) {
+    if (PRINT_FINAL_PAGE_TABLES) { printProcessPageTables(); }
+    if (PRINT_FINAL_FRAME_TABLE) { printFrameTable(); }
+    if (PRINT_FINAL_STATS) {
+        printProcessStats();
+        if (tlb != nullptr) { tlb->printStats(); }
+        if (cleaner != nullptr) { cleaner->printStats(); }
+        if (zswap != nullptr) { zswap->printStats(zswapBaseCost); }
+        if (SHARED_OBJECTS) { printSharingStats(); }
+        if (profiler != nullptr) { profiler->printStats(); }
+        if (NUMA_NODES > 1) { printNumaStats(); }
+        if (HUGE_PAGE_SIZE > 0) { printHugePageStats(); }
+        if (quotas != nullptr) { quotas->printStats(); }
+        printSimulationStats();
+    }
+}
+
+// the thread_local state a finished run leaves behind, handed back to the main thread for its reports
+struct RunState {
+    char algo;
+    int frames;
+    FrameTable* frameTable = nullptr;
+    vector<Process*> processList;
+    unsigned long instCount = 0, ctxSwitches = 0, processExits = 0;
+    unsigned long long totalCost = 0, zswapBaseCost = 0;
+    TLB* tlb = nullptr;
+    PageCleaner* cleaner = nullptr;
+    ZswapPool* zswap = nullptr;
+    FrameQuotas* quotas = nullptr;
+    map<long long, FrameEntry*> objectFrames;
+    unsigned long sharedMappings = 0, peakSharedMappings = 0;
+    string error;
+};
+
+// one pager and frame count on the calling thread, with its own processes and page tables over the shared
+// trace and VMAs
+void runConfiguration(RunState& run, InstructionStream* sharedTrace, const vector<Process*>& sharedProcesses) {
+    // a worker thread runs one configuration after the other, the previous run was handed over in its RunState
+    delete trace;
+    trace = new InstructionStream(*sharedTrace);
+    tlb = nullptr, cleaner = nullptr, zswap = nullptr, quotas = nullptr;
+    processList = newProcesses(sharedProcesses);
+    resetSimulation();
+    PAGING_ALGO_PARAM = run.algo;
+    FRAME_TABLE_SIZE = run.frames;
+    setupRunState();
+    frameTable = new FrameTable(FRAME_TABLE_SIZE, getPagingAlgorithm());
+    runSimulation();
+    if (zswap != nullptr && PRINT_FINAL_STATS) {
+        run.zswapBaseCost = runWithoutZswap();
+    }
+    run.frameTable = frameTable, run.processList = processList, run.tlb = tlb, run.cleaner = cleaner, run.zswap = zswap, run.quotas = quotas;
+    run.instCount = instCount, run.ctxSwitches = ctxSwitches, run.processExits = processExits, run.totalCost = totalCost;
+    run.objectFrames.swap(objectFrames);
+    run.sharedMappings = sharedMappings, run.peakSharedMappings = peakSharedMappings;
+}
+
+// -j: every pager of -a with every frame count of -f, spread over PARALLEL_RUNS threads. The trace is decoded
+// once and shared read-only, the runs report in order as RUN lines followed by the usual -oP/-oF/-oS output.
+void runParallel() {
+    vector<RunState> runs;
+    for (auto algo = PAGING_ALGOS.begin(); algo != PAGING_ALGOS.end(); ++algo) {
+        if (std::strchr("frceawol", *algo) == nullptr) {
+            continue;
+        }
+        for (auto frames = FRAME_COUNTS.begin(); frames != FRAME_COUNTS.end(); ++frames) {
+            RunState run;
+            run.algo = *algo;
+            run.frames = max(1, *frames);
+            runs.push_back(run);
+        }
+    }
+    trace->decode();
+    if (PAGING_ALGOS.find('o') != string::npos) {
+        buildNextUseIndex();
+    }
+    // nothing is printed while the runs are interleaved, the flags are set once before the workers start
+    silenceSimulation();
+
+    InstructionStream* sharedTrace = trace;
+    const vector<Process*>& sharedProcesses = processList;
+    atomic<size_t> nextRun(0);
+    vector<thread> workers;
+    for (int i = 0; i < min(PARALLEL_RUNS, (int) runs.size()); i++) {
+        workers.push_back(thread([&]() {
+            for (size_t r = nextRun++; r < runs.size(); r = nextRun++) {
+                try {
+                    runConfiguration(runs[r], sharedTrace, sharedProcesses);
+                } catch (const std::exception& e) {
+                    runs[r].error = e.what();
+                }
+            }
+        }));
+    }
+    for (auto it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+
+    vector<Process*> loadedProcesses = processList;
+    for (auto run = runs.begin(); run != runs.end(); ++run) {
+        if (!run->error.empty()) {
+            std::cerr << "Caught unexpected exception: " << run->error << std::endl;
+            continue;
+        }
+        frameTable = run->frameTable, processList = run->processList, tlb = run->tlb, cleaner = run->cleaner, zswap = run->zswap, quotas = run->quotas;
+        instCount = run->instCount, ctxSwitches = run->ctxSwitches, processExits = run->processExits, totalCost = run->totalCost;
+        objectFrames.swap(run->objectFrames);
+        sharedMappings = run->sharedMappings, peakSharedMappings = run->peakSharedMappings;
+        FRAME_TABLE_SIZE = frameTable->frames.size();
+        unsigned long long faults = 0;
+        for (auto it = processList.begin(); it != processList.end(); ++it) {
+            faults = faults + (*it)->pstats->maps - (*it)->pstats->prefetches;
+        }
+        printf("RUN: %c %d %llu %llu\n", run->algo, run->frames, faults, totalCost);
+        printFinalReports(run->zswapBaseCost);
+    }
+    processList = loadedProcesses;
+}
+
 int main(int argc, char** argv) {
+    // a large buffer keeps the -oOxyf printouts, which can run to gigabytes, out of the simulation's time
+    setvbuf(stdout, nullptr, _IOFBF, 1 << 20);
     try {
         readArguments(argc, argv);
+        if (!PROFILE_FILE.empty() && (MRC_MAX_FRAMES > 0 || PARALLEL_RUNS > 0)) {
+            // the profile follows one run, -m and -j make many
+            cout << "-h cannot be combined with -m or -j\n";
+            return 0;
+        }
         readInputFile(INPUT_FILE);
+        if (!CONVERT_FILE.empty()) {
+            writeBinaryTrace(CONVERT_FILE);
+            return 0;
+        }
         readRandomFile(RAND_FILE);
+        if (PARALLEL_RUNS > 0 && MRC_MAX_FRAMES == 0) {
+            runParallel();
+            return 0;
+        }
+        if (MRC_MAX_FRAMES > 0) {
+            // -m<max>: faults and cost for every frame count up to max, LRU uses the one-pass stack analysis
+            // where it applies
+            PRINT_EXITS = false;
+            if (PAGING_ALGO_PARAM == 'l' && lruStackAnalysisApplies()) {
+                runLRUMissRatioCurve();
+            } else {
+                runPagerMissRatioCurve();
+            }
+            return 0;
+        }
+        if (!PROFILE_FILE.empty()) {
+            profiler = new FaultProfiler(PROFILE_FILE);
+            if (!profiler->isOpen()) {
+                cout << "Unable to open file " << PROFILE_FILE << "\n";
+                return 0;
+            }
+        }
         Pager* pager = getPagingAlgorithm();
+        if (pager == nullptr) {
+            cout << "Unknown paging algorithm " << PAGING_ALGO_PARAM << "\n";
+            return 0;
+        }
+        setupRunState();
         frameTable = new FrameTable(FRAME_TABLE_SIZE, pager);
         runSimulation();
-        if (PRINT_FINAL_PAGE_TABLES) { printProcessPageTables(); }
-        if (PRINT_FINAL_FRAME_TABLE) { printFrameTable(); }
-        if (PRINT_FINAL_STATS) {
-            printProcessStats();
-            printSimulationStats();
+        if (profiler != nullptr) { profiler->finish(); }
+        unsigned long long zswapBaseCost = 0;
+        if (zswap != nullptr && PRINT_FINAL_STATS) {
+            silenceSimulation();
+            zswapBaseCost = runWithoutZswap();
         }
+        printFinalReports(zswapBaseCost);
     } catch (const std::exception& e) {
         std::cerr << "Caught unexpected exception: " << e.what() << std::endl;
     } catch (...) {
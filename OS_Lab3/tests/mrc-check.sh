@@ -0,0 +1,13 @@
+#!/bin/sh
+# usage: mrc-check.sh <maxframes> <inputfile> <randomfile> [options]
+# every point of the -m curve has to cost what a -f run with that frame count does
+max=$1 in=$2 rfile=$3; shift 3
+./mmu -m$max "$@" $in $rfile | awk '$1 == "MRC:" { print $2, $5 }' > mrc-check.curve
+f=1
+while [ $f -le $max ]; do
+    ./mmu -f$f -oS "$@" $in $rfile | awk -v f=$f '$1 == "TOTALCOST" { print f, $5 }'
+    f=$((f + 1))
+done | diff mrc-check.curve -
+status=$?
+rm -f mrc-check.curve
+exit $status